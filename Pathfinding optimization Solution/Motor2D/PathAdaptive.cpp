@@ -0,0 +1,141 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "j1App.h"
+#include "j1PathFinding.h"
+#include "PathAdaptive.h"
+
+AdaptiveSearch::AdaptiveSearch()
+{}
+
+void AdaptiveSearch::SetMap(uint width, uint height)
+{
+	CleanUp();
+
+	this->width = width;
+	this->height = height;
+}
+
+void AdaptiveSearch::CleanUp()
+{
+	tables.clear();
+	tables.shrink_to_fit();
+	expanded.clear();
+	expanded_g.clear();
+	width = height = clock = last_expansions = 0;
+}
+
+void AdaptiveSearch::SetMaxGoals(uint goals)
+{
+	max_goals = MAX(goals, 1);
+	if (tables.size() > max_goals)
+		tables.resize(max_goals);
+}
+
+void AdaptiveSearch::SetTile(bool opened)
+{
+	if (opened == true && tables.size() != 0)
+	{
+		LOG("Adaptive search: a tile opened, forgetting %u goals", tables.size());
+		tables.clear();
+	}
+}
+
+uint AdaptiveSearch::GetLastExpansions() const
+{
+	return last_expansions;
+}
+
+// The table of the goal, or the one used longest ago starting over for it
+AdaptiveSearch::GoalTable& AdaptiveSearch::TableFor(const iPoint& goal)
+{
+	clock++;
+
+	GoalTable* oldest = nullptr;
+	for (std::vector<GoalTable>::iterator item = tables.begin(); item != tables.end(); ++item)
+	{
+		if (item->goal == goal)
+		{
+			item->last_used = clock;
+			return *item;
+		}
+
+		if (oldest == nullptr || item->last_used < oldest->last_used)
+			oldest = &*item;
+	}
+
+	if (tables.size() < max_goals)
+	{
+		tables.push_back(GoalTable());
+		oldest = &tables.back();
+	}
+
+	oldest->goal = goal;
+	oldest->last_used = clock;
+	oldest->learned.assign(width*height, 0);
+	return *oldest;
+}
+
+// ----------------------------------------------------------------------------------
+// Hooks of the shared A*: h = max(octile, learned) keeps tiles learned as unreachable
+// out, expanded tiles are kept with their g to learn from once the search ends
+// ----------------------------------------------------------------------------------
+struct AdaptiveHooks : public SearchHooks<DefaultSearchPolicy>
+{
+	AdaptiveHooks(std::vector<int>& learned, std::vector<uint>& expanded, std::vector<int>& expanded_g, uint width) :
+		learned(learned), expanded(expanded), expanded_g(expanded_g), width(width)
+	{}
+
+	inline int H(const iPoint& pos, const iPoint& destination)
+	{
+		int h = learned[(pos.y * width) + pos.x];
+		if (h == ADAPTIVE_UNREACHABLE)
+			return -1;
+
+		return MAX(DefaultSearchPolicy::H(pos, destination), h);
+	}
+
+	inline bool Expand(const PathNode* node)
+	{
+		expanded.push_back((node->pos.y * width) + node->pos.x);
+		expanded_g.push_back((int)node->g);
+		return true;
+	}
+
+	inline void Done(const PathNode* goal)
+	{
+		if (goal != nullptr)
+		{
+			int goal_g = (int)goal->g;
+			for (uint i = 0; i < expanded.size(); ++i)
+				learned[expanded[i]] = MAX(learned[expanded[i]], goal_g - expanded_g[i]);
+		}
+		else
+		{
+			// every tile the origin reaches was expanded and none of them is the goal
+			for (uint i = 0; i < expanded.size(); ++i)
+				learned[expanded[i]] = ADAPTIVE_UNREACHABLE;
+		}
+	}
+
+	std::vector<int>& learned;
+	std::vector<uint>& expanded;
+	std::vector<int>& expanded_g;
+	uint width;
+};
+
+bool AdaptiveSearch::FindPath(SearchContext& context, const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill)
+{
+	last_expansions = 0;
+
+	if (width == 0 || App->pathfinding->IsWalkable(origin) == false || App->pathfinding->IsWalkable(destination) == false)
+		return false;
+
+	expanded.clear();
+	expanded_g.clear();
+
+	AdaptiveHooks hooks(TableFor(destination).learned, expanded, expanded_g, width);
+	bool ret = App->pathfinding->FindPath<DefaultSearchPolicy>(context, origin, destination, path_to_fill, hooks);
+	last_expansions = expanded.size();
+
+	return ret;
+}
@@ -0,0 +1,77 @@
+#ifndef __PATHADAPTIVE_H__
+#define __PATHADAPTIVE_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+
+// goals that keep a learned heuristic at the same time
+#define DEFAULT_ADAPTIVE_GOALS 4
+// learned value of tiles that can't reach the goal
+#define ADAPTIVE_UNREACHABLE 0x3fffffff
+
+// --------------------------------------------------
+// Generalized Adaptive A*
+// Sun, Koenig, Yeoh: "Generalized Adaptive A*"
+// Once a search reaches the goal, every tile it expanded is at least
+// g(goal) - g(tile) away from it, so that becomes its heuristic for the next
+// search to the same goal, wherever it starts from. The learned heuristic stays
+// consistent and only grows, each new search toward a goal expands fewer tiles.
+// Tiles of a search that finds no path can't reach the goal at all.
+// Closing a tile only makes paths longer and keeps what was learned, opening one
+// can make them shorter and every goal starts over.
+// --------------------------------------------------
+class SearchContext;
+
+// ---------------------------------------------------------------------
+// AdaptiveSearch: learned heuristics of the most recent goals
+// ---------------------------------------------------------------------
+class AdaptiveSearch
+{
+public:
+
+	AdaptiveSearch();
+
+	// Forgets every goal, tables are sized for a map of this size
+	void SetMap(uint width, uint height);
+
+	// Releases the tables
+	void CleanUp();
+
+	void SetMaxGoals(uint goals);
+
+	// A tile changed, an opened one drops what was learned
+	void SetTile(bool opened);
+
+	// A* with the learned heuristic of the destination, learns from the tiles it expands
+	bool FindPath(SearchContext& context, const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill);
+
+	// Tiles expanded by the last search
+	uint GetLastExpansions() const;
+
+private:
+
+	struct GoalTable
+	{
+		iPoint goal;
+		uint last_used;
+		// 0 until the tile is expanded by a search to this goal
+		std::vector<int> learned;
+	};
+
+	GoalTable& TableFor(const iPoint& goal);
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	uint max_goals = DEFAULT_ADAPTIVE_GOALS;
+	uint clock = 0;
+	uint last_expansions = 0;
+	std::vector<GoalTable> tables;
+	// closed tiles of the search in progress
+	std::vector<uint> expanded;
+	std::vector<int> expanded_g;
+};
+
+#endif // __PATHADAPTIVE_H__
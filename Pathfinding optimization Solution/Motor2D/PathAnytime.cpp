@@ -0,0 +1,328 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "j1App.h"
+#include "j1PathFinding.h"
+#include "PathAnytime.h"
+#include <algorithm>
+
+// how many expansions between two reads of the frame budget timer
+#define ANYTIME_TIMER_CHECK 16
+
+AnytimeRequest::AnytimeRequest(uint id, const iPoint& origin, const iPoint& destination, float epsilon) :
+	id(id), origin(origin), destination(destination), epsilon(MAX(epsilon, 1.0f)), bound(0.0f), version(0), finished(false)
+{}
+
+AnytimeSearch::Search::Search()
+{
+	context = new SearchContext();
+}
+
+AnytimeSearch::Search::~Search()
+{
+	RELEASE(context);
+}
+
+AnytimeSearch::AnytimeSearch()
+{}
+
+// Destructor
+AnytimeSearch::~AnytimeSearch()
+{
+	CleanUp();
+}
+
+void AnytimeSearch::SetMap(uint width, uint height)
+{
+	Reset();
+
+	this->width = width;
+	this->height = height;
+
+	// the first request on the map shouldn't pay for growing a node map
+	if (free_searches.size() == 0)
+		free_searches.push_back(new Search());
+	free_searches.back()->context->Begin(width, height);
+}
+
+void AnytimeSearch::CleanUp()
+{
+	Reset();
+
+	for (std::vector<Search*>::iterator item = free_searches.begin(); item != free_searches.end(); ++item)
+		RELEASE(*item);
+	free_searches.clear();
+
+	width = height = 0;
+}
+
+void AnytimeSearch::Reset()
+{
+	for (std::vector<Search*>::iterator item = searches.begin(); item != searches.end(); ++item)
+		free_searches.push_back(*item);
+	searches.clear();
+}
+
+void AnytimeSearch::Release(uint id)
+{
+	for (std::vector<Search*>::iterator item = searches.begin(); item != searches.end(); ++item)
+	{
+		if ((*item)->owner == id)
+		{
+			free_searches.push_back(*item);
+			searches.erase(item);
+			break;
+		}
+	}
+}
+
+AnytimeSearch::Search* AnytimeSearch::Find(uint id) const
+{
+	for (std::vector<Search*>::const_iterator item = searches.begin(); item != searches.end(); ++item)
+	{
+		if ((*item)->owner == id)
+			return *item;
+	}
+
+	return nullptr;
+}
+
+// AnytimeSearch --------------------------------------------------------------------
+// Entries are never removed from the heap when a node improves: the old one
+// just becomes stale and is skipped when it reaches the top
+// ----------------------------------------------------------------------------------
+void AnytimeSearch::Push(Search& search, PathNode* node)
+{
+	OpenEntry entry;
+	entry.g = node->g;
+	entry.key = node->g + search.epsilon * node->h;
+	entry.node = node;
+	search.open.push_back(entry);
+	std::push_heap(search.open.begin(), search.open.end(), OpenCompare());
+}
+
+bool AnytimeSearch::IsStale(const OpenEntry& entry) const
+{
+	return entry.node->on_open == false || entry.node->g != entry.g;
+}
+
+// New search for the request in a pooled context, the context stamp resets the
+// nodes lazily as they are reached
+AnytimeSearch::Search* AnytimeSearch::Restart(AnytimeRequest& request)
+{
+	Release(request.id);
+
+	Search* search;
+	if (free_searches.size() != 0)
+	{
+		search = free_searches.back();
+		free_searches.pop_back();
+	}
+	else
+	{
+		search = new Search();
+	}
+	searches.push_back(search);
+
+	search->open.clear();
+	search->incons.clear();
+	search->closed.clear();
+	search->context->Begin(width, height);
+	search->owner = request.id;
+	search->epsilon = request.epsilon;
+	search->destination = request.destination;
+	search->goal = search->context->GetNode(request.destination.x, request.destination.y);
+
+	PathNode* first = search->context->GetNode(request.origin.x, request.origin.y);
+	first->g = 0;
+	first->h = DefaultSearchPolicy::H(request.origin, request.destination);
+	first->on_open = true;
+	Push(*search, first);
+
+	return search;
+}
+
+// AnytimeSearch --------------------------------------------------------------------
+// One ARA* ImprovePath: expands while the goal g is above the lowest key.
+// Returns false if the budget runs out first, the state is kept to resume later
+// ----------------------------------------------------------------------------------
+bool AnytimeSearch::ImprovePath(Search& search, j1PerfTimer& timer, double budget_ms)
+{
+	std::vector<OpenEntry>& open = search.open;
+	uint map_width, map_height;
+	const uchar* map = App->pathfinding->GetWalkabilityMap(map_width, map_height);
+	uint expansions = 0;
+
+	while (open.size() != 0)
+	{
+		const OpenEntry& top = open.front();
+
+		if (IsStale(top))
+		{
+			std::pop_heap(open.begin(), open.end(), OpenCompare());
+			open.pop_back();
+			continue;
+		}
+
+		if (search.goal->g >= 0 && search.goal->g <= top.key)
+			return true;
+
+		if ((++expansions % ANYTIME_TIMER_CHECK) == 0 && timer.ReadMs() >= budget_ms)
+			return false;
+
+		PathNode* current = top.node;
+		std::pop_heap(open.begin(), open.end(), OpenCompare());
+		open.pop_back();
+
+		current->on_open = false;
+		current->on_close = true;
+		search.closed.push_back(current);
+
+		auto visit = [&](int x, int y, int cost)
+		{
+			PathNode* node = search.context->GetNode(x, y);
+			if (node->h < 0)
+				node->h = DefaultSearchPolicy::H(node->pos, search.destination);
+
+			float new_g = current->g + cost;
+			if (node->g < 0 || new_g < node->g)
+			{
+				node->g = new_g;
+				node->parent = current;
+
+				if (node->on_close == false)
+				{
+					node->on_open = true;
+					Push(search, node);
+				}
+				else
+				{
+					search.incons.push_back(node);
+				}
+			}
+		};
+		GridNeighbours<DefaultSearchPolicy>::Expand(map, map_width, map_height, current->pos.x, current->pos.y, visit);
+	}
+
+	return true;
+}
+
+// AnytimeSearch --------------------------------------------------------------------
+// ARA* sub-optimality bound: g(goal) / min(g + h) over OPEN and INCONS
+// ----------------------------------------------------------------------------------
+float AnytimeSearch::ProvenBound(const Search& search) const
+{
+	float min_f = -1.0f;
+
+	for (std::vector<OpenEntry>::const_iterator item = search.open.begin(); item != search.open.end(); ++item)
+	{
+		if (IsStale(*item) == false && (min_f < 0 || item->node->Score() < min_f))
+			min_f = item->node->Score();
+	}
+
+	for (std::vector<PathNode*>::const_iterator item = search.incons.begin(); item != search.incons.end(); ++item)
+	{
+		if (min_f < 0 || (*item)->Score() < min_f)
+			min_f = (*item)->Score();
+	}
+
+	// nothing is left inconsistent, the g values are already optimal
+	if (min_f <= 0)
+		return 1.0f;
+
+	return MAX(1.0f, MIN(search.epsilon, search.goal->g / min_f));
+}
+
+void AnytimeSearch::Publish(const Search& search, AnytimeRequest& request, float bound)
+{
+	request.path.clear();
+
+	for (const PathNode* node = search.goal; node != nullptr; node = node->parent)
+		request.path.push_back(node->pos);
+
+	std::reverse(request.path.begin(), request.path.end());
+	request.bound = bound;
+	request.version++;
+}
+
+// AnytimeSearch --------------------------------------------------------------------
+// Lowers epsilon, moves INCONS into OPEN, empties CLOSED and reorders the heap
+// ----------------------------------------------------------------------------------
+void AnytimeSearch::NextIteration(Search& search, float new_epsilon)
+{
+	std::vector<OpenEntry>& open = search.open;
+	std::vector<PathNode*>& incons = search.incons;
+	std::vector<PathNode*>& closed = search.closed;
+	search.epsilon = new_epsilon;
+
+	for (std::vector<PathNode*>::iterator item = closed.begin(); item != closed.end(); ++item)
+		(*item)->on_close = false;
+	closed.clear();
+
+	std::vector<OpenEntry>::iterator last = std::remove_if(open.begin(), open.end(), [this](const OpenEntry& entry) { return IsStale(entry); });
+	open.erase(last, open.end());
+
+	for (std::vector<PathNode*>::iterator item = incons.begin(); item != incons.end(); ++item)
+	{
+		if ((*item)->on_open == false)
+		{
+			(*item)->on_open = true;
+			OpenEntry entry;
+			entry.g = (*item)->g;
+			entry.node = *item;
+			open.push_back(entry);
+		}
+	}
+	incons.clear();
+
+	for (std::vector<OpenEntry>::iterator item = open.begin(); item != open.end(); ++item)
+		item->key = item->node->g + search.epsilon * item->node->h;
+
+	std::make_heap(open.begin(), open.end(), OpenCompare());
+}
+
+// AnytimeSearch --------------------------------------------------------------------
+// Runs ImprovePath iterations with a decreasing epsilon until the budget is spent.
+// A request without a search (new, or reset by a map change) starts one from the
+// epsilon it had reached
+// ----------------------------------------------------------------------------------
+bool AnytimeSearch::Improve(AnytimeRequest& request, double budget_ms)
+{
+	if (request.finished == true)
+		return true;
+
+	j1PerfTimer timer;
+
+	Search* search = Find(request.id);
+	if (search == nullptr)
+		search = Restart(request);
+
+	while (ImprovePath(*search, timer, budget_ms) == true)
+	{
+		if (search->goal->g < 0)
+		{
+			LOG("Anytime path %u: destination unreachable", request.id);
+			request.finished = true;
+			break;
+		}
+
+		float bound = ProvenBound(*search);
+		Publish(*search, request, bound);
+
+		if (search->epsilon <= 1.0f || bound <= 1.0f)
+		{
+			request.finished = true;
+			break;
+		}
+
+		request.epsilon = MAX(1.0f, search->epsilon - ANYTIME_EPSILON_STEP);
+		NextIteration(*search, request.epsilon);
+
+		if (timer.ReadMs() >= budget_ms)
+			break;
+	}
+
+	if (request.finished == true)
+		Release(request.id);
+
+	return request.finished;
+}
@@ -0,0 +1,126 @@
+#ifndef __PATHANYTIME_H__
+#define __PATHANYTIME_H__
+
+#include "p2Point.h"
+#include "j1PerfTimer.h"
+#include <vector>
+
+#define ANYTIME_EPSILON_STEP 0.5f
+
+// --------------------------------------------------
+// Anytime Repairing A* (ARA*)
+// Likhachev, Gordon, Thrun: "ARA*: Anytime A* with Provable Bounds on Sub-Optimality"
+// The first path comes from an inflated heuristic (epsilon > 1) and is refined
+// frame after frame reusing the previous search effort until epsilon reaches 1.
+// Every request keeps its own search, node states live in a stamped
+// SearchContext taken from a pool: starting a search touches no more of the
+// map than it expands, and a new request leaves the ones in progress alone.
+// --------------------------------------------------
+struct PathNode;
+class SearchContext;
+
+// ---------------------------------------------------------------------
+// AnytimeRequest: one anytime query and the best path found so far
+// ---------------------------------------------------------------------
+struct AnytimeRequest
+{
+	AnytimeRequest(uint id, const iPoint& origin, const iPoint& destination, float epsilon);
+
+	uint id;
+	iPoint origin;
+	iPoint destination;
+	// inflation used by the search that is currently running
+	float epsilon;
+	// cost(path) <= bound * cost(optimal path), 0 while there is no path yet
+	float bound;
+	// increased every time path is replaced by a better one
+	uint version;
+	bool finished;
+	// tiles from origin to destination
+	std::vector<iPoint> path;
+};
+
+// ---------------------------------------------------------------------
+// AnytimeSearch: ARA* state of every request, a search can be interrupted
+// at the end of the frame budget and resumed on the next frame
+// ---------------------------------------------------------------------
+class AnytimeSearch
+{
+public:
+
+	AnytimeSearch();
+
+	// Destructor
+	~AnytimeSearch();
+
+	// Forgets every search, one context is warmed up for a map of this size
+	void SetMap(uint width, uint height);
+
+	// Releases every search and context
+	void CleanUp();
+
+	// Forgets the searches in progress, next Improve on each request starts from scratch
+	void Reset();
+
+	// Drops the search of this request, its context goes back to the pool
+	void Release(uint id);
+
+	// Refines the request for at most budget_ms, returns true once it is finished
+	bool Improve(AnytimeRequest& request, double budget_ms);
+
+private:
+
+	struct OpenEntry
+	{
+		float key;
+		float g;
+		PathNode* node;
+	};
+
+	struct OpenCompare
+	{
+		bool operator()(const OpenEntry& l, const OpenEntry& r) const
+		{
+			return l.key > r.key;
+		}
+	};
+
+	// ARA* state of one request
+	struct Search
+	{
+		Search();
+		~Search();
+
+		uint owner = 0;
+		SearchContext* context;
+		// open list as a binary heap so the keys can be rebuilt when epsilon changes
+		std::vector<OpenEntry> open;
+		// closed nodes that got a better g during this iteration
+		std::vector<PathNode*> incons;
+		// closed nodes of this iteration, to clear their flag on the next one
+		std::vector<PathNode*> closed;
+		float epsilon = 1.0f;
+		iPoint destination;
+		PathNode* goal = nullptr;
+	};
+
+	Search* Find(uint id) const;
+	Search* Restart(AnytimeRequest& request);
+	bool ImprovePath(Search& search, j1PerfTimer& timer, double budget_ms);
+	void NextIteration(Search& search, float new_epsilon);
+	float ProvenBound(const Search& search) const;
+	void Publish(const Search& search, AnytimeRequest& request, float bound);
+
+	void Push(Search& search, PathNode* node);
+	bool IsStale(const OpenEntry& entry) const;
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	// searches of the requests being refined and the ones ready to be reused
+	std::vector<Search*> searches;
+	std::vector<Search*> free_searches;
+};
+
+#endif // __PATHANYTIME_H__
@@ -0,0 +1,96 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "PathArena.h"
+
+#define SLOT_MASK ((1u << PATH_HANDLE_SLOT_BITS) - 1)
+#define GENERATION_MASK ((1u << (32 - PATH_HANDLE_SLOT_BITS)) - 1)
+
+PathArena::PathArena()
+{}
+
+// Destructor
+PathArena::~PathArena()
+{
+	Clear();
+}
+
+void PathArena::Clear()
+{
+	for (std::vector<Slot*>::iterator item = slots.begin(); item != slots.end(); ++item)
+		RELEASE(*item);
+
+	slots.clear();
+	free_slots.clear();
+}
+
+uint PathArena::GetLiveCount() const
+{
+	return slots.size() - free_slots.size();
+}
+
+PathHandle PathArena::Acquire(std::vector<iPoint>*& storage)
+{
+	uint index;
+
+	if (free_slots.size() != 0)
+	{
+		index = free_slots.back();
+		free_slots.pop_back();
+	}
+	else
+	{
+		if (slots.size() > SLOT_MASK)
+		{
+			LOG("Path arena: more than %u results alive", SLOT_MASK);
+			storage = nullptr;
+			return PATH_HANDLE_NONE;
+		}
+
+		index = slots.size();
+		slots.push_back(new Slot());
+	}
+
+	Slot* slot = slots[index];
+	slot->live = true;
+	slot->path.clear();
+	storage = &slot->path;
+
+	return (slot->generation << PATH_HANDLE_SLOT_BITS) | index;
+}
+
+const PathArena::Slot* PathArena::Find(PathHandle handle) const
+{
+	uint index = handle & SLOT_MASK;
+	if (handle == PATH_HANDLE_NONE || index >= slots.size())
+		return nullptr;
+
+	const Slot* slot = slots[index];
+	return (slot->live == true && slot->generation == (handle >> PATH_HANDLE_SLOT_BITS)) ? slot : nullptr;
+}
+
+// Generations skip 0 so a handle is never PATH_HANDLE_NONE
+void PathArena::Release(PathHandle handle)
+{
+	if (Find(handle) == nullptr)
+		return;
+
+	uint index = handle & SLOT_MASK;
+	Slot* slot = slots[index];
+	slot->live = false;
+	slot->generation = MAX((slot->generation + 1) & GENERATION_MASK, 1);
+	free_slots.push_back(index);
+}
+
+PathSpan PathArena::Get(PathHandle handle) const
+{
+	PathSpan span = { nullptr, 0 };
+
+	const Slot* slot = Find(handle);
+	if (slot != nullptr && slot->path.size() != 0)
+	{
+		span.data = &slot->path[0];
+		span.size = slot->path.size();
+	}
+
+	return span;
+}
@@ -0,0 +1,81 @@
+#ifndef __PATHARENA_H__
+#define __PATHARENA_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+
+// low bits of a handle are the slot, the rest its generation
+#define PATH_HANDLE_SLOT_BITS 16
+#define PATH_HANDLE_NONE 0
+
+// --------------------------------------------------
+// Pooled path results
+// Every result lives in a slot of the arena until its handle is released, so
+// any number of them can be alive at once and nothing has to be copied out of
+// last_path. Searches write the path straight into the slot vector, released
+// slots keep their capacity and a warm arena allocates nothing. Handles carry
+// the generation of their slot: a released handle reads as an empty path
+// instead of whatever result reused the slot. Main thread only.
+// --------------------------------------------------
+typedef uint PathHandle;
+
+// ---------------------------------------------------------------------
+// PathSpan: read-only view of a result, valid until its handle is released
+// ---------------------------------------------------------------------
+struct PathSpan
+{
+	const iPoint* data;
+	uint size;
+
+	const iPoint* begin() const { return data; }
+	const iPoint* end() const { return data + size; }
+	const iPoint& operator[](uint index) const { return data[index]; }
+};
+
+// ---------------------------------------------------------------------
+// PathArena: result slots and the free ones
+// ---------------------------------------------------------------------
+class PathArena
+{
+public:
+
+	PathArena();
+
+	// Destructor
+	~PathArena();
+
+	// New handle and the empty vector its path goes in, the vector stays where it
+	// is until the handle is released
+	PathHandle Acquire(std::vector<iPoint>*& storage);
+
+	// Frees the slot, the handle reads empty from now on
+	void Release(PathHandle handle);
+
+	// Empty span for released or unknown handles
+	PathSpan Get(PathHandle handle) const;
+
+	// Results alive
+	uint GetLiveCount() const;
+
+	// Releases every result and frees the slots
+	void Clear();
+
+private:
+
+	struct Slot
+	{
+		std::vector<iPoint> path;
+		uint generation = 1;
+		bool live = false;
+	};
+
+	const Slot* Find(PathHandle handle) const;
+
+private:
+
+	std::vector<Slot*> slots;
+	std::vector<uint> free_slots;
+};
+
+#endif // __PATHARENA_H__
@@ -0,0 +1,440 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "j1App.h"
+#include "j1PathFinding.h"
+#include "PathBounded.h"
+#include <algorithm>
+
+// fringe search gives up before the open addressing gets too slow
+#define FRINGE_MAX_LOAD(size) ((size) - ((size) >> 2))
+#define BOUNDED_NONE -1
+
+typedef GridNeighbours<DefaultSearchPolicy> Neighbours;
+
+BoundedSearch::BoundedSearch()
+{}
+
+// Destructor
+BoundedSearch::~BoundedSearch()
+{
+	CleanUp();
+}
+
+void BoundedSearch::SetTableSize(uint size)
+{
+	CleanUp();
+
+	table_size = 1;
+	while (table_size < size)
+		table_size <<= 1;
+	table_mask = table_size - 1;
+
+	table_bytes = table_size * MAX(sizeof(IDAEntry), sizeof(FringeEntry));
+	table = new uchar[table_bytes];
+	iteration = 0;
+}
+
+void BoundedSearch::CleanUp()
+{
+	RELEASE_ARRAY(table);
+	table_bytes = table_size = table_mask = 0;
+	stack.clear();
+	ClearComponents();
+}
+
+void BoundedSearch::SetMap(uint width, uint height, const uchar* map)
+{
+	this->width = width;
+	this->height = height;
+	Label(map);
+}
+
+void BoundedSearch::ClearComponents()
+{
+	labels.clear();
+	labels.shrink_to_fit();
+	stale = false;
+}
+
+// Diagonal steps need both side tiles free, so 4-connected components are the 8-connected ones
+void BoundedSearch::Label(const uchar* map)
+{
+	labels.assign(width*height, 0);
+	next_label = 1;
+	stale = false;
+
+	std::vector<uint> pending;
+	for (uint i = 0; i < width*height; ++i)
+	{
+		if (labels[i] != 0 || Neighbours::Walkable(map, width, height, i % width, i / width) == false)
+			continue;
+
+		unsigned short label = next_label;
+		if (next_label != BOUNDED_LABEL_UNKNOWN)
+			next_label++;
+
+		labels[i] = label;
+		pending.push_back(i);
+
+		while (pending.size() != 0)
+		{
+			uint tile = pending.back();
+			pending.pop_back();
+			int x = tile % width, y = tile / width;
+
+			for (uint dir = 0; dir < 4; ++dir)
+			{
+				int nx = x + grid_dirs[dir][0], ny = y + grid_dirs[dir][1];
+				if (Neighbours::Walkable(map, width, height, nx, ny) == false)
+					continue;
+
+				uint next = (ny * width) + nx;
+				if (labels[next] == 0)
+				{
+					labels[next] = label;
+					pending.push_back(next);
+				}
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------------
+// The tiles around pos in ring order, each one sharing a side with the next. A
+// closed tile can only split its component if its open sides are in more than one
+// run of open ring tiles. An opened tile with a single label around keeps it
+// ----------------------------------------------------------------------------------
+void BoundedSearch::SetTile(const iPoint& pos, const uchar* map)
+{
+	if (labels.size() == 0 || stale == true)
+		return;
+
+	static const int ring[8][2] = { { 0, -1 },{ 1, -1 },{ 1, 0 },{ 1, 1 },{ 0, 1 },{ -1, 1 },{ -1, 0 },{ -1, -1 } };
+	uint index = (pos.y * width) + pos.x;
+	bool walkable = Neighbours::Walkable(map, width, height, pos.x, pos.y);
+
+	if (walkable == false)
+	{
+		labels[index] = 0;
+
+		bool open[8];
+		for (uint i = 0; i < 8; ++i)
+			open[i] = Neighbours::Walkable(map, width, height, pos.x + ring[i][0], pos.y + ring[i][1]);
+
+		uint runs = 0;
+		for (uint i = 0; i < 8; i += 2)
+		{
+			// a side starts a run unless the ring tiles before it are open up to another side
+			if (open[i] == true && (open[(i + 7) & 7] == false || open[(i + 6) & 7] == false))
+				runs++;
+		}
+
+		// no run at all means the ring is open all around
+		stale = (runs > 1);
+		return;
+	}
+
+	unsigned short label = 0;
+	for (uint dir = 0; dir < 4 && stale == false; ++dir)
+	{
+		int nx = pos.x + grid_dirs[dir][0], ny = pos.y + grid_dirs[dir][1];
+		if (Neighbours::Walkable(map, width, height, nx, ny) == false)
+			continue;
+
+		unsigned short around = labels[(ny * width) + nx];
+		if (label == 0)
+			label = around;
+		else if (around != label)
+			stale = true;
+	}
+
+	if (label == 0)
+	{
+		label = next_label;
+		if (next_label != BOUNDED_LABEL_UNKNOWN)
+			next_label++;
+	}
+
+	labels[index] = label;
+}
+
+bool BoundedSearch::Connected(const iPoint& origin, const iPoint& destination)
+{
+	if (labels.size() == 0)
+		return true;
+
+	if (stale == true)
+	{
+		LOG("Bounded search: relabelling components after a tile change");
+		Label(App->pathfinding->GetWalkabilityMap(width, height));
+	}
+
+	unsigned short a = labels[(origin.y * width) + origin.x];
+	unsigned short b = labels[(destination.y * width) + destination.x];
+	if (a == 0 || b == 0)
+		return false;
+
+	return a == b || a == BOUNDED_LABEL_UNKNOWN || b == BOUNDED_LABEL_UNKNOWN;
+}
+
+bool BoundedSearch::FringeOverflowed() const
+{
+	return overflow;
+}
+
+uint BoundedSearch::GetMemoryUsage() const
+{
+	return table_bytes + stack.capacity() * sizeof(IDAFrame) + labels.capacity() * sizeof(unsigned short);
+}
+
+// ----------------------------------------------------------------------------------
+// IDA*: depth first passes with a growing f threshold. The table remembers the
+// best g each tile has been reached with, which prunes both transpositions and
+// cycles. Slots are simply overwritten on collision, that only costs time
+// ----------------------------------------------------------------------------------
+bool BoundedSearch::FindPathIDA(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill)
+{
+	if (table == nullptr || Connected(origin, destination) == false)
+		return false;
+
+	IDAEntry* entries = (IDAEntry*)table;
+	const uchar* map = App->pathfinding->GetWalkabilityMap(width, height);
+	int threshold = DefaultSearchPolicy::H(origin, destination);
+
+	if (origin == destination)
+	{
+		path_to_fill.push_back(origin);
+		return true;
+	}
+
+	// the block may hold fringe slots, start again from a clean table
+	IDAEntry empty = { BOUNDED_NONE, 0, 0 };
+	std::fill(entries, entries + table_size, empty);
+	iteration = 0;
+
+	while (true)
+	{
+		++iteration;
+
+		int next_threshold = -1;
+		IDAFrame first = { origin, 0, 0 };
+		stack.clear();
+		stack.push_back(first);
+
+		while (stack.size() != 0)
+		{
+			IDAFrame& top = stack.back();
+
+			if (top.dir == DefaultSearchPolicy::Neighbourhood::DIRECTIONS)
+			{
+				stack.pop_back();
+				continue;
+			}
+
+			uint dir = top.dir++;
+			int cost = Neighbours::Step(map, width, height, top.pos.x, top.pos.y, dir);
+			if (cost == 0)
+				continue;
+
+			IDAFrame child;
+			child.pos.create(top.pos.x + grid_dirs[dir][0], top.pos.y + grid_dirs[dir][1]);
+			child.g = top.g + cost;
+			child.dir = 0;
+
+			int f = child.g + DefaultSearchPolicy::H(child.pos, destination);
+			if (f > threshold)
+			{
+				if (next_threshold < 0 || f < next_threshold)
+					next_threshold = f;
+				continue;
+			}
+
+			// a worse g than one already seen can't be part of an optimal path,
+			// the same g only needs to be explored once per pass
+			int tile = (child.pos.y * width) + child.pos.x;
+			IDAEntry& entry = entries[tile & table_mask];
+			if (entry.tile == tile && (child.g > entry.g || (child.g == entry.g && entry.iteration == iteration)))
+				continue;
+
+			entry.tile = tile;
+			entry.g = child.g;
+			entry.iteration = iteration;
+
+			stack.push_back(child);
+
+			if (child.pos == destination)
+			{
+				for (std::vector<IDAFrame>::const_iterator item = stack.begin(); item != stack.end(); ++item)
+					path_to_fill.push_back(item->pos);
+				return true;
+			}
+		}
+
+		// nothing was pruned by the threshold: every reachable tile has been seen
+		if (next_threshold < 0)
+			return false;
+
+		threshold = next_threshold;
+	}
+}
+
+// ----------------------------------------------------------------------------------
+// Fringe search helpers: the table is open addressed by tile and also holds the
+// fringe as a doubly linked list threaded through its slots
+// ----------------------------------------------------------------------------------
+int BoundedSearch::FindFringeEntry(int tile, bool create)
+{
+	FringeEntry* entries = (FringeEntry*)table;
+	uint index = ((uint)tile * 2654435761u) & table_mask;
+
+	while (entries[index].tile != BOUNDED_NONE)
+	{
+		if (entries[index].tile == tile)
+			return index;
+		index = (index + 1) & table_mask;
+	}
+
+	if (create == false || fringe_used >= FRINGE_MAX_LOAD(table_size))
+		return BOUNDED_NONE;
+
+	fringe_used++;
+	FringeEntry& entry = entries[index];
+	entry.tile = tile;
+	entry.g = -1;
+	entry.parent = BOUNDED_NONE;
+	entry.prev = entry.next = BOUNDED_NONE;
+	entry.in_fringe = false;
+	return index;
+}
+
+void BoundedSearch::FringeUnlink(int index)
+{
+	FringeEntry* entries = (FringeEntry*)table;
+	FringeEntry& entry = entries[index];
+
+	if (entry.prev != BOUNDED_NONE)
+		entries[entry.prev].next = entry.next;
+	if (entry.next != BOUNDED_NONE)
+		entries[entry.next].prev = entry.prev;
+
+	entry.prev = entry.next = BOUNDED_NONE;
+	entry.in_fringe = false;
+}
+
+void BoundedSearch::FringeInsertAfter(int index, int after)
+{
+	FringeEntry* entries = (FringeEntry*)table;
+	FringeEntry& entry = entries[index];
+
+	entry.prev = after;
+	entry.next = entries[after].next;
+	if (entry.next != BOUNDED_NONE)
+		entries[entry.next].prev = index;
+	entries[after].next = index;
+	entry.in_fringe = true;
+}
+
+// ----------------------------------------------------------------------------------
+// Fringe search: IDA* thresholds over a single list that is kept between passes,
+// so tiles under the threshold are not expanded again on every iteration
+// ----------------------------------------------------------------------------------
+bool BoundedSearch::FindPathFringe(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill)
+{
+	overflow = false;
+	if (table == nullptr || Connected(origin, destination) == false)
+		return false;
+
+	FringeEntry* entries = (FringeEntry*)table;
+	const uchar* map = App->pathfinding->GetWalkabilityMap(width, height);
+	for (uint i = 0; i < table_size; ++i)
+		entries[i].tile = BOUNDED_NONE;
+	fringe_used = 0;
+	overflow = false;
+
+	int head = FindFringeEntry((origin.y * width) + origin.x, true);
+	entries[head].g = 0;
+	entries[head].in_fringe = true;
+
+	int threshold = DefaultSearchPolicy::H(origin, destination);
+	int goal = BOUNDED_NONE;
+
+	while (goal == BOUNDED_NONE && head != BOUNDED_NONE)
+	{
+		int next_threshold = -1;
+		int index = head;
+
+		while (index != BOUNDED_NONE)
+		{
+			FringeEntry& entry = entries[index];
+			iPoint pos(entry.tile % width, entry.tile / width);
+			int f = entry.g + DefaultSearchPolicy::H(pos, destination);
+
+			if (f > threshold)
+			{
+				if (next_threshold < 0 || f < next_threshold)
+					next_threshold = f;
+				index = entry.next;
+				continue;
+			}
+
+			if (pos == destination)
+			{
+				goal = index;
+				break;
+			}
+
+			for (int dir = DefaultSearchPolicy::Neighbourhood::DIRECTIONS - 1; dir >= 0; --dir)
+			{
+				int cost = Neighbours::Step(map, width, height, pos.x, pos.y, dir);
+				if (cost == 0)
+					continue;
+
+				int tile = ((pos.y + grid_dirs[dir][1]) * width) + pos.x + grid_dirs[dir][0];
+				int g = entry.g + cost;
+				int child = FindFringeEntry(tile, true);
+
+				if (child == BOUNDED_NONE)
+				{
+					LOG("Fringe search ran out of table after %u tiles", fringe_used);
+					overflow = true;
+					return false;
+				}
+
+				if (entries[child].g >= 0 && g >= entries[child].g)
+					continue;
+
+				if (entries[child].in_fringe == true)
+				{
+					if (child == head)
+						head = entries[child].next;
+					FringeUnlink(child);
+				}
+
+				entries[child].g = g;
+				entries[child].parent = index;
+				FringeInsertAfter(child, index);
+			}
+
+			int next = entry.next;
+			if (index == head)
+				head = next;
+			FringeUnlink(index);
+			index = next;
+		}
+
+		if (next_threshold < 0)
+			break;
+
+		threshold = next_threshold;
+	}
+
+	if (goal == BOUNDED_NONE)
+		return false;
+
+	uint first = path_to_fill.size();
+	for (int index = goal; index != BOUNDED_NONE; index = entries[index].parent)
+		path_to_fill.push_back(iPoint(entries[index].tile % width, entries[index].tile / width));
+	std::reverse(path_to_fill.begin() + first, path_to_fill.end());
+
+	return true;
+}
@@ -0,0 +1,116 @@
+#ifndef __PATHBOUNDED_H__
+#define __PATHBOUNDED_H__
+
+#include "p2Point.h"
+#include <vector>
+
+#define DEFAULT_BOUNDED_TABLE_SIZE 65536
+// component of the tiles labelled after the first 65534 components
+#define BOUNDED_LABEL_UNKNOWN 0xFFFF
+
+// --------------------------------------------------
+// Memory bounded searches for maps too big for a node map
+// IDA*: Korf, "Depth-first iterative-deepening: an optimal admissible tree search"
+// Fringe search: Bjornsson, Enzenberger, Holte, Schaeffer, "Fringe Search: Beating A* at Pathfinding on Game Maps"
+// Both only use the fixed size table allocated in SetTableSize plus O(path) memory.
+// Neither can tell an unreachable destination before it has seen every tile it
+// can reach, IDA* once per threshold, so endpoints are first checked against
+// component labels of 16 bits per tile.
+// --------------------------------------------------
+class BoundedSearch
+{
+public:
+
+	BoundedSearch();
+
+	// Destructor
+	~BoundedSearch();
+
+	// Allocates the transposition table, size is rounded up to a power of two
+	void SetTableSize(uint size);
+
+	// Releases the transposition table and the labels
+	void CleanUp();
+
+	// Labels the components of a map the searches will run on
+	void SetMap(uint width, uint height, const uchar* map);
+
+	// Frees the labels, searches no longer check the endpoints
+	void ClearComponents();
+
+	// A tile changed: labels are redone on the next search if it may have split or
+	// joined components
+	void SetTile(const iPoint& pos, const uchar* map);
+
+	// False when the endpoints are in different components
+	bool Connected(const iPoint& origin, const iPoint& destination);
+
+	// IDA* with a lossy transposition table, never runs out of memory
+	bool FindPathIDA(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill);
+
+	// Fringe search, fails when the visited tiles no longer fit in the table
+	bool FindPathFringe(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill);
+
+	// True when the last fringe search failed because the table was full
+	bool FringeOverflowed() const;
+
+	// Bytes used by the table and the labels
+	uint GetMemoryUsage() const;
+
+private:
+
+	// IDA* table slot: best g that reached the tile during one iteration
+	struct IDAEntry
+	{
+		int tile;
+		int g;
+		uint iteration;
+	};
+
+	// Fringe search slot: cached g and parent plus the fringe links
+	struct FringeEntry
+	{
+		int tile;
+		int g;
+		int parent;
+		int prev;
+		int next;
+		bool in_fringe;
+	};
+
+	struct IDAFrame
+	{
+		iPoint pos;
+		int g;
+		uint dir;
+	};
+
+	void Label(const uchar* map);
+	int FindFringeEntry(int tile, bool create);
+	void FringeUnlink(int index);
+	void FringeInsertAfter(int index, int after);
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	uint table_mask = 0;
+
+	// both algorithms share the same block, only one of them runs at a time
+	uchar* table = nullptr;
+	uint table_bytes = 0;
+	uint table_size = 0;
+	uint fringe_used = 0;
+	bool overflow = false;
+	uint iteration = 0;
+
+	// O(path) stack of the depth first search
+	std::vector<IDAFrame> stack;
+
+	// 4-connected component of every tile, 0 for blocked ones
+	std::vector<unsigned short> labels;
+	unsigned short next_label = 1;
+	bool stale = false;
+};
+
+#endif // __PATHBOUNDED_H__
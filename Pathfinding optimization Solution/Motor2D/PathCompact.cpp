@@ -0,0 +1,128 @@
+#include "p2Defs.h"
+#include "j1App.h"
+#include "j1Render.h"
+#include "j1Map.h"
+#include "PathPolicies.h"
+#include "PathCompact.h"
+
+// grid_dirs index of every step, by (dy + 1) * 3 + dx + 1, -1 for no step
+static const int step_dirs[9] = { 7, 1, 6, 3, -1, 2, 5, 0, 4 };
+
+#define RUN_DIR(run) ((run) & 7)
+#define RUN_LENGTH(run) ((uint)((run) >> 3) + 1)
+
+CompactPath::Iterator::Iterator(const CompactPath* path, uint index) : path(path), index(index), pos(path->start)
+{}
+
+CompactPath::Iterator& CompactPath::Iterator::operator++()
+{
+	if (++index >= path->Size())
+		return *this;
+
+	uchar value = path->runs[run];
+	pos.x += grid_dirs[RUN_DIR(value)][0];
+	pos.y += grid_dirs[RUN_DIR(value)][1];
+
+	if (++taken == RUN_LENGTH(value))
+	{
+		run++;
+		taken = 0;
+	}
+
+	return *this;
+}
+
+CompactPath::CompactPath()
+{}
+
+void CompactPath::Clear()
+{
+	runs.clear();
+	tiles = 0;
+	start.create(0, 0);
+}
+
+uint CompactPath::Size() const
+{
+	return tiles;
+}
+
+const iPoint& CompactPath::Start() const
+{
+	return start;
+}
+
+uint CompactPath::GetMemoryUsage() const
+{
+	return runs.capacity();
+}
+
+CompactPath::Iterator CompactPath::begin() const
+{
+	return Iterator(this, 0);
+}
+
+CompactPath::Iterator CompactPath::end() const
+{
+	return Iterator(this, Size());
+}
+
+bool CompactPath::Encode(const std::vector<iPoint>& path)
+{
+	Clear();
+
+	if (path.size() == 0)
+		return true;
+
+	start = path[0];
+	tiles = path.size();
+	for (uint i = 1; i < path.size(); ++i)
+	{
+		int dx = path[i].x - path[i - 1].x, dy = path[i].y - path[i - 1].y;
+		int dir = (dx < -1 || dx > 1 || dy < -1 || dy > 1) ? -1 : step_dirs[((dy + 1) * 3) + dx + 1];
+		if (dir < 0)
+		{
+			Clear();
+			return false;
+		}
+
+		// a full run or a turn starts a new byte
+		if (runs.size() != 0 && RUN_DIR(runs.back()) == dir && RUN_LENGTH(runs.back()) < COMPACT_MAX_RUN)
+			runs.back() += 1 << 3;
+		else
+			runs.push_back((uchar)dir);
+	}
+
+	runs.shrink_to_fit();
+	return true;
+}
+
+void CompactPath::Decode(std::vector<iPoint>& path_to_fill) const
+{
+	path_to_fill.clear();
+
+	for (Iterator item = begin(); item != end(); ++item)
+		path_to_fill.push_back(*item);
+}
+
+void CompactPath::WorldWaypoints(std::vector<iPoint>& waypoints) const
+{
+	waypoints.clear();
+
+	if (Size() == 0)
+		return;
+
+	iPoint pos = start;
+	waypoints.push_back(App->map->MapToWorld(pos.x, pos.y));
+
+	for (uint i = 0; i < runs.size(); ++i)
+	{
+		uint dir = RUN_DIR(runs[i]), length = RUN_LENGTH(runs[i]);
+		pos.x += grid_dirs[dir][0] * length;
+		pos.y += grid_dirs[dir][1] * length;
+
+		// runs split at COMPACT_MAX_RUN go on in the same direction
+		if (i + 1 == runs.size() || RUN_DIR(runs[i + 1]) != dir)
+			waypoints.push_back(App->map->MapToWorld(pos.x, pos.y));
+	}
+}
@@ -0,0 +1,85 @@
+#ifndef __PATHCOMPACT_H__
+#define __PATHCOMPACT_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+
+// steps one run byte can hold
+#define COMPACT_MAX_RUN 32
+
+// --------------------------------------------------
+// Compact tile path
+// The start tile and then one byte per straight run of steps: the low 3 bits
+// are the direction (a grid_dirs index) and the high 5 the run length minus
+// one. A path that turns every step takes a byte per tile instead of the 8 of
+// an iPoint, straight and diagonal stretches take a byte per 32 tiles. Tiles
+// are decoded on the fly by the iterator, and the ends of the runs are the
+// points where the path turns, which are the world waypoints.
+// --------------------------------------------------
+
+// ---------------------------------------------------------------------
+// CompactPath: start tile and direction runs
+// ---------------------------------------------------------------------
+class CompactPath
+{
+public:
+
+	// ---------------------------------------------------------------------
+	// Iterator: tiles from start to end, decoded one step at a time
+	// ---------------------------------------------------------------------
+	class Iterator
+	{
+	public:
+
+		Iterator(const CompactPath* path, uint index);
+
+		const iPoint& operator*() const { return pos; }
+		const iPoint* operator->() const { return &pos; }
+		Iterator& operator++();
+		bool operator==(const Iterator& other) const { return index == other.index; }
+		bool operator!=(const Iterator& other) const { return index != other.index; }
+
+	private:
+
+		const CompactPath* path;
+		// tiles already passed, the end iterator is at Size()
+		uint index;
+		uint run = 0;
+		uint taken = 0;
+		iPoint pos;
+	};
+
+	CompactPath();
+
+	// Encodes a tile path, false (and left empty) if two consecutive tiles aren't neighbours
+	bool Encode(const std::vector<iPoint>& path);
+
+	// Tiles of the path, path_to_fill keeps its capacity
+	void Decode(std::vector<iPoint>& path_to_fill) const;
+
+	// Start, every tile where the direction changes and the end, converted
+	// to world coordinates by the map
+	void WorldWaypoints(std::vector<iPoint>& waypoints) const;
+
+	void Clear();
+
+	// Number of tiles, start included
+	uint Size() const;
+
+	const iPoint& Start() const;
+
+	// Bytes used by the runs
+	uint GetMemoryUsage() const;
+
+	Iterator begin() const;
+	Iterator end() const;
+
+private:
+
+	iPoint start;
+	uint tiles = 0;
+	std::vector<uchar> runs;
+};
+
+#endif // __PATHCOMPACT_H__
@@ -0,0 +1,317 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "PathPolicies.h"
+#include "PathDatabase.h"
+#include <windows.h>
+#include <stdio.h>
+#include <thread>
+#include <functional>
+#include <algorithm>
+
+#define CPD_WORDS(count) (sizeof(Header) / sizeof(uint32) + (count))
+
+typedef GridNeighbours<DefaultSearchPolicy> Neighbours;
+
+PathDatabase::PathDatabase()
+{}
+
+// Destructor
+PathDatabase::~PathDatabase()
+{
+	CleanUp();
+}
+
+void PathDatabase::CleanUp()
+{
+	if (view != nullptr)
+		UnmapViewOfFile(view);
+	if (mapping != nullptr)
+		CloseHandle(mapping);
+	if (file != nullptr)
+		CloseHandle(file);
+
+	view = mapping = file = nullptr;
+	built.clear();
+	built.shrink_to_fit();
+	components = offsets = runs = nullptr;
+	width = height = 0;
+	map_hash = 0;
+}
+
+bool PathDatabase::IsLoaded() const
+{
+	return runs != nullptr;
+}
+
+// FNV-1a over walkable / not walkable, the values themselves don't change a path
+uint32 PathDatabase::HashMap(uint width, uint height, const uchar* map)
+{
+	uint32 ret = 2166136261u;
+
+	for (uint i = 0; i < width*height; ++i)
+	{
+		ret ^= Neighbours::Walkable(map, width, height, i % width, i / width) ? 1 : 0;
+		ret *= 16777619u;
+	}
+
+	return ret;
+}
+
+void PathDatabase::Point(const Header* header)
+{
+	width = header->width;
+	height = header->height;
+	map_hash = header->map_hash;
+	components = (const uint32*)(header + 1);
+	offsets = components + width*height;
+	runs = offsets + width*height + 1;
+}
+
+// ----------------------------------------------------------------------------------
+// Dijkstra from a source where each tile inherits the first move of its parent
+// ----------------------------------------------------------------------------------
+void PathDatabase::FirstMoves(uint width, uint height, const uchar* map, uint source, std::vector<int>& cost, std::vector<uchar>& first_move, std::vector<std::pair<int, int>>& open)
+{
+	typedef std::pair<int, int> Entry;
+
+	cost.assign(width*height, -1);
+	first_move.resize(width*height);
+	open.clear();
+	cost[source] = 0;
+	open.push_back(Entry(0, source));
+
+	while (open.size() != 0)
+	{
+		std::pop_heap(open.begin(), open.end(), std::greater<Entry>());
+		Entry current = open.back();
+		open.pop_back();
+
+		if (current.first > cost[current.second])
+			continue;
+
+		int x = current.second % width, y = current.second / width;
+		for (uint dir = 0; dir < DefaultSearchPolicy::Neighbourhood::DIRECTIONS; ++dir)
+		{
+			int step_cost = Neighbours::Step(map, width, height, x, y, dir);
+			if (step_cost == 0)
+				continue;
+
+			int tile = ((y + grid_dirs[dir][1]) * width) + x + grid_dirs[dir][0];
+			int g = current.first + step_cost;
+			if (cost[tile] >= 0 && g >= cost[tile])
+				continue;
+
+			cost[tile] = g;
+			first_move[tile] = ((uint)current.second == source) ? dir : first_move[current.second];
+			open.push_back(Entry(g, tile));
+			std::push_heap(open.begin(), open.end(), std::greater<Entry>());
+		}
+	}
+}
+
+// Targets of every source this thread owns are scanned in row order into runs
+void PathDatabase::BuildSources(const uchar* map, uint first, uint step, std::vector<std::vector<uint32>>* source_runs) const
+{
+	uint tiles = width*height;
+	std::vector<int> cost;
+	std::vector<uchar> first_move;
+	std::vector<std::pair<int, int>> open;
+
+	for (uint source = first; source < tiles; source += step)
+	{
+		if (components[source] == 0)
+			continue;
+
+		FirstMoves(width, height, map, source, cost, first_move, open);
+
+		std::vector<uint32>& source_run = (*source_runs)[source];
+		uint current_move = CPD_NO_MOVE;
+
+		for (uint target = 0; target < tiles; ++target)
+		{
+			// targets nobody will ask for don't break runs
+			if (target == source || components[target] != components[source])
+				continue;
+
+			if (first_move[target] != current_move || source_run.size() == 0)
+			{
+				current_move = first_move[target];
+				source_run.push_back((target << 4) | current_move);
+			}
+		}
+		source_run.shrink_to_fit();
+	}
+}
+
+bool PathDatabase::Build(uint width, uint height, const uchar* map, uint threads)
+{
+	CleanUp();
+
+	uint tiles = width*height;
+	Header header = { { 'C', 'P', 'D', '1' }, CPD_VERSION, width, height, HashMap(width, height, map), 0 };
+
+	// components first, a lookup between two of them has no answer
+	built.assign(CPD_WORDS(tiles + tiles + 1), 0);
+	memcpy(built.data(), &header, sizeof(Header));
+	Point((const Header*)built.data());
+
+	uint32* component = (uint32*)components;
+	uint32 next_component = 0;
+	std::vector<uint> stack;
+
+	for (uint i = 0; i < tiles; ++i)
+	{
+		if (component[i] != 0 || Neighbours::Walkable(map, width, height, i % width, i / width) == false)
+			continue;
+
+		component[i] = ++next_component;
+		stack.push_back(i);
+		while (stack.size() != 0)
+		{
+			uint tile = stack.back();
+			stack.pop_back();
+
+			auto visit = [&](int x, int y, int cost)
+			{
+				uint next = (y * width) + x;
+				if (component[next] == 0)
+				{
+					component[next] = next_component;
+					stack.push_back(next);
+				}
+			};
+			Neighbours::Expand(map, width, height, tile % width, tile / width, visit);
+		}
+	}
+
+	// sources are dealt round robin so every thread gets a similar share of open and blocked areas
+	if (threads == 0)
+		threads = MAX(std::thread::hardware_concurrency(), 1u);
+
+	std::vector<std::vector<uint32>> source_runs(tiles);
+	std::vector<std::thread> workers;
+	for (uint i = 1; i < threads; ++i)
+		workers.push_back(std::thread(&PathDatabase::BuildSources, this, map, i, threads, &source_runs));
+	BuildSources(map, 0, threads, &source_runs);
+
+	for (std::vector<std::thread>::iterator item = workers.begin(); item != workers.end(); ++item)
+		item->join();
+
+	uint run_count = 0;
+	for (uint i = 0; i < tiles; ++i)
+		run_count += source_runs[i].size();
+
+	header.run_count = run_count;
+	built.resize(CPD_WORDS(tiles + tiles + 1 + run_count));
+	memcpy(built.data(), &header, sizeof(Header));
+	Point((const Header*)built.data());
+
+	uint32* offset = (uint32*)offsets;
+	uint32* run = (uint32*)runs;
+	offset[0] = 0;
+	for (uint i = 0; i < tiles; ++i)
+	{
+		std::copy(source_runs[i].begin(), source_runs[i].end(), run + offset[i]);
+		offset[i + 1] = offset[i] + source_runs[i].size();
+	}
+
+	LOG("Path database: %u components, %u runs, %u bytes", next_component, run_count, built.size() * sizeof(uint32));
+	return true;
+}
+
+bool PathDatabase::Save(const char* path) const
+{
+	if (built.size() == 0)
+		return false;
+
+	FILE* output = nullptr;
+	if (fopen_s(&output, path, "wb") != 0 || output == nullptr)
+	{
+		LOG("Could not write path database %s", path);
+		return false;
+	}
+
+	bool ret = fwrite(built.data(), sizeof(uint32), built.size(), output) == built.size();
+	fclose(output);
+	return ret;
+}
+
+// The file is mapped read only and never copied, pages come in on first use
+bool PathDatabase::Load(const char* path, uint width, uint height, const uchar* map)
+{
+	CleanUp();
+
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = nullptr;
+		LOG("Could not open path database %s", path);
+		return false;
+	}
+
+	DWORD size = GetFileSize(file, NULL);
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	view = (mapping != nullptr) ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+	const Header* header = (const Header*)view;
+	bool valid = header != nullptr && size >= sizeof(Header) &&
+		memcmp(header->magic, "CPD1", 4) == 0 && header->version == CPD_VERSION &&
+		header->width == width && header->height == height &&
+		size == CPD_WORDS(width*height * 2 + 1 + header->run_count) * sizeof(uint32) &&
+		header->map_hash == HashMap(width, height, map);
+
+	if (valid == false)
+	{
+		LOG("Path database %s does not match the current map", path);
+		CleanUp();
+		return false;
+	}
+
+	Point(header);
+	LOG("Path database %s: %u runs", path, header->run_count);
+	return true;
+}
+
+uint32 PathDatabase::Component(const iPoint& pos) const
+{
+	if (components == nullptr || pos.x < 0 || pos.y < 0 || pos.x >= (int)width || pos.y >= (int)height)
+		return 0;
+
+	return components[(pos.y * width) + pos.x];
+}
+
+// Last run starting at or before the target, wildcards before the first run belong to it
+uint PathDatabase::FirstMove(const iPoint& from, const iPoint& to) const
+{
+	uint32 component = Component(from);
+	if (component == 0 || from == to || Component(to) != component)
+		return CPD_NO_MOVE;
+
+	uint source = (from.y * width) + from.x;
+	uint target = (to.y * width) + to.x;
+
+	const uint32* first = runs + offsets[source];
+	const uint32* last = runs + offsets[source + 1];
+	const uint32* run = std::upper_bound(first, last, (target << 4) | 0xF);
+
+	return ((run == first) ? *first : *(run - 1)) & 0xF;
+}
+
+bool PathDatabase::FindPath(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const
+{
+	uint32 component = Component(origin);
+	if (component == 0 || Component(destination) != component)
+		return false;
+
+	path_to_fill.clear();
+	path_to_fill.push_back(origin);
+
+	for (iPoint pos = origin; pos != destination; )
+	{
+		uint move = FirstMove(pos, destination);
+		pos.create(pos.x + grid_dirs[move][0], pos.y + grid_dirs[move][1]);
+		path_to_fill.push_back(pos);
+	}
+
+	return true;
+}
@@ -0,0 +1,96 @@
+#ifndef __PATHDATABASE_H__
+#define __PATHDATABASE_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+
+#define CPD_VERSION 1
+#define CPD_NO_MOVE 15
+
+// --------------------------------------------------
+// Compressed path database
+// Botea, Strasser, Harabor: "Complexity Results for Compressed Path Databases"
+// For every source tile the first move of an optimal path to every target is
+// stored as runs over the targets in row order. Unwalkable targets and targets
+// in another component are never asked for, so they extend whatever run they
+// fall in. Databases are built offline (see PathDatabaseBuilder) and mapped
+// read-only at load, a path is a chain of first-move lookups.
+// --------------------------------------------------
+
+// ---------------------------------------------------------------------
+// PathDatabase: builds, saves and memory maps first-move tables
+// ---------------------------------------------------------------------
+class PathDatabase
+{
+public:
+
+	PathDatabase();
+
+	// Destructor
+	~PathDatabase();
+
+	// Builds the tables of a walkability map with a Dijkstra from every tile, threads 0 uses every cpu
+	bool Build(uint width, uint height, const uchar* map, uint threads = 0);
+
+	// Writes what Build made
+	bool Save(const char* path) const;
+
+	// Maps a database file, fails if it was not built for this walkability map
+	bool Load(const char* path, uint width, uint height, const uchar* map);
+
+	// Unmaps or frees the tables
+	void CleanUp();
+
+	bool IsLoaded() const;
+
+	// First move of an optimal path (an index of grid_dirs) or CPD_NO_MOVE
+	uint FirstMove(const iPoint& from, const iPoint& to) const;
+
+	// Path from origin to destination by repeated first-move lookups
+	bool FindPath(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const;
+
+	// Walkability hash stored in the header, databases of other maps are refused
+	static uint32 HashMap(uint width, uint height, const uchar* map);
+
+	// Dijkstra from source: cost of every tile (-1 if unreachable) and the first move towards it
+	static void FirstMoves(uint width, uint height, const uchar* map, uint source, std::vector<int>& cost, std::vector<uchar>& first_move, std::vector<std::pair<int, int>>& open);
+
+private:
+
+	struct Header
+	{
+		char magic[4];
+		uint32 version;
+		uint32 width;
+		uint32 height;
+		uint32 map_hash;
+		uint32 run_count;
+	};
+
+	void BuildSources(const uchar* map, uint first, uint step, std::vector<std::vector<uint32>>* source_runs) const;
+	void Point(const Header* header);
+	// 0 for unwalkable tiles or tiles outside the map
+	uint32 Component(const iPoint& pos) const;
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	uint32 map_hash = 0;
+
+	// views over the mapped file or the built tables
+	const uint32* components = nullptr;
+	const uint32* offsets = nullptr;
+	// (first target << 4) | move
+	const uint32* runs = nullptr;
+
+	// tables owned when built instead of loaded
+	std::vector<uint32> built;
+
+	void* file = nullptr;
+	void* mapping = nullptr;
+	const void* view = nullptr;
+};
+
+#endif // __PATHDATABASE_H__
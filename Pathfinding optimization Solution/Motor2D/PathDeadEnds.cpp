@@ -0,0 +1,218 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "PathPolicies.h"
+#include "PathDeadEnds.h"
+#include <algorithm>
+
+typedef GridNeighbours<DefaultSearchPolicy> Neighbours;
+
+DeadEnds::DeadEnds()
+{}
+
+void DeadEnds::CleanUp()
+{
+	regions.clear();
+	regions.shrink_to_fit();
+	width = height = 0;
+	region_count = next_region = 0;
+}
+
+uint DeadEnds::GetRegionCount() const
+{
+	return region_count;
+}
+
+uint DeadEnds::GetRegion(const iPoint& pos) const
+{
+	if (regions.size() == 0 || pos.x < 0 || pos.y < 0 || pos.x >= (int)width || pos.y >= (int)height)
+		return 0;
+
+	return regions[(pos.y * width) + pos.x];
+}
+
+// Regions are labelled biggest first: a smaller one is either inside a labelled
+// region already or doesn't touch any
+void DeadEnds::SetMap(uint width, uint height, const uchar* map)
+{
+	CleanUp();
+
+	this->width = width;
+	this->height = height;
+
+	uint tiles = width*height;
+	regions.assign(tiles, 0);
+	discovery.assign(tiles, 0);
+	low.resize(tiles);
+	parent.resize(tiles);
+	size.resize(tiles);
+
+	std::vector<Candidate> candidates;
+	for (uint tile = 0; tile < tiles; ++tile)
+	{
+		if (discovery[tile] != 0 || Neighbours::Walkable(map, width, height, tile % width, tile / width) == false)
+			continue;
+
+		candidates.clear();
+		FindCandidates(map, tile, candidates);
+		std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.size > b.size; });
+
+		for (std::vector<Candidate>::const_iterator item = candidates.begin(); item != candidates.end(); ++item)
+		{
+			if (regions[item->start] == 0)
+			{
+				Fill(map, item->start, item->cut, ++next_region);
+				region_count++;
+			}
+		}
+	}
+
+	discovery.clear();
+	discovery.shrink_to_fit();
+	low.clear();
+	low.shrink_to_fit();
+	parent.clear();
+	parent.shrink_to_fit();
+	size.clear();
+	size.shrink_to_fit();
+
+	LOG("Dead ends: %u regions", region_count);
+}
+
+// ----------------------------------------------------------------------------------
+// Iterative Tarjan over the component of root. A child c of v with low[c] >= discovery[v]
+// hangs from v alone: its subtree is one side of v and the tiles left out of every such
+// subtree (the parent side) are another
+// ----------------------------------------------------------------------------------
+void DeadEnds::FindCandidates(const uchar* map, int root, std::vector<Candidate>& candidates)
+{
+	struct Frame
+	{
+		int tile;
+		uint dir;
+	};
+
+	std::vector<Frame> stack;
+	// tiles hanging from each tile on the stack through its cut children
+	std::vector<uint> hanging;
+	std::vector<Candidate> parent_sides;
+	int time = 0;
+
+	discovery[root] = low[root] = ++time;
+	parent[root] = -1;
+	size[root] = 1;
+	Frame first = { root, 0 };
+	stack.push_back(first);
+	hanging.push_back(0);
+
+	while (stack.size() != 0)
+	{
+		int tile = stack.back().tile;
+		uint dir = stack.back().dir;
+
+		if (dir < DefaultSearchPolicy::Neighbourhood::DIRECTIONS)
+		{
+			stack.back().dir++;
+
+			int x = tile % width, y = tile / width;
+			if (Neighbours::Step(map, width, height, x, y, dir) == 0)
+				continue;
+
+			int next = ((y + grid_dirs[dir][1]) * width) + x + grid_dirs[dir][0];
+			if (discovery[next] == 0)
+			{
+				discovery[next] = low[next] = ++time;
+				parent[next] = tile;
+				size[next] = 1;
+				Frame frame = { next, 0 };
+				stack.push_back(frame);
+				hanging.push_back(0);
+			}
+			else if (next != parent[tile])
+			{
+				low[tile] = MIN(low[tile], discovery[next]);
+			}
+			continue;
+		}
+
+		// every child of tile is done
+		uint tile_hanging = hanging.back();
+		stack.pop_back();
+		hanging.pop_back();
+
+		int up = parent[tile];
+		if (up < 0)
+			continue;
+
+		if (tile_hanging != 0)
+		{
+			Candidate candidate = { tile_hanging, up, tile };
+			parent_sides.push_back(candidate);
+		}
+
+		low[up] = MIN(low[up], low[tile]);
+		size[up] += size[tile];
+
+		if (low[tile] >= discovery[up])
+		{
+			Candidate candidate = { size[tile], tile, up };
+			candidates.push_back(candidate);
+			hanging.back() += size[tile];
+		}
+	}
+
+	// the parent side is whatever the cut tile and its hanging subtrees leave
+	uint component = size[root];
+	for (std::vector<Candidate>::iterator item = parent_sides.begin(); item != parent_sides.end(); ++item)
+	{
+		item->size = component - 1 - item->size;
+		candidates.push_back(*item);
+	}
+
+	candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+		[component](const Candidate& item) { return item.size * 2 >= component; }), candidates.end());
+}
+
+void DeadEnds::Fill(const uchar* map, int start, int cut, uint region)
+{
+	std::vector<int> stack(1, start);
+	regions[start] = region;
+
+	while (stack.size() != 0)
+	{
+		int tile = stack.back();
+		stack.pop_back();
+
+		auto visit = [&](int x, int y, int cost)
+		{
+			int next = (y * width) + x;
+			if (next != cut && regions[next] == 0)
+			{
+				regions[next] = region;
+				stack.push_back(next);
+			}
+		};
+		Neighbours::Expand(map, width, height, tile % width, tile / width, visit);
+	}
+}
+
+void DeadEnds::Drop(uint region)
+{
+	std::replace(regions.begin(), regions.end(), region, 0u);
+	region_count--;
+}
+
+void DeadEnds::SetTile(const iPoint& pos, const uchar* map)
+{
+	if (regions.size() == 0 || Neighbours::Walkable(map, width, height, pos.x, pos.y) == false)
+		return;
+
+	for (int dy = -1; dy <= 1; ++dy)
+	{
+		for (int dx = -1; dx <= 1; ++dx)
+		{
+			uint region = GetRegion(iPoint(pos.x + dx, pos.y + dy));
+			if (region != 0)
+				Drop(region);
+		}
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef __PATHDEADENDS_H__
+#define __PATHDEADENDS_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+
+// --------------------------------------------------
+// Dead-end regions
+// A region that only joins the rest of the map through a single tile (a cut
+// tile) cannot be on an optimal path unless the origin or the destination is
+// inside it: entering and leaving would cross the cut tile twice. Cut tiles are
+// found with Tarjan's articulation point search at SetMap. Every tile keeps the
+// outermost region holding it, only regions smaller than half of their
+// component are kept so two of them either nest or don't touch.
+// --------------------------------------------------
+
+// ---------------------------------------------------------------------
+// DeadEnds: region of every tile, 0 for tiles that can be on any path
+// ---------------------------------------------------------------------
+class DeadEnds
+{
+public:
+
+	DeadEnds();
+
+	// Finds the regions of a walkability map
+	void SetMap(uint width, uint height, const uchar* map);
+
+	// Frees the regions
+	void CleanUp();
+
+	// A tile that opens can join a region to the rest of the map, the regions
+	// around it are dropped. A tile that closes leaves every region valid
+	void SetTile(const iPoint& pos, const uchar* map);
+
+	uint GetRegion(const iPoint& pos) const;
+
+	// True if the tile is in a region none of the endpoints is in
+	inline bool Skip(int x, int y, uint origin_region, uint destination_region) const
+	{
+		uint region = regions[(y * width) + x];
+		return region != 0 && region != origin_region && region != destination_region;
+	}
+
+	uint GetRegionCount() const;
+
+private:
+
+	// one side of a cut tile, start is any tile of it
+	struct Candidate
+	{
+		uint size;
+		int start;
+		int cut;
+	};
+
+	void FindCandidates(const uchar* map, int root, std::vector<Candidate>& candidates);
+	void Fill(const uchar* map, int start, int cut, uint region);
+	void Drop(uint region);
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	uint region_count = 0;
+	uint next_region = 0;
+	std::vector<uint> regions;
+
+	// Tarjan scratch, only alive during SetMap
+	std::vector<int> discovery;
+	std::vector<int> low;
+	std::vector<int> parent;
+	std::vector<uint> size;
+};
+
+#endif // __PATHDEADENDS_H__
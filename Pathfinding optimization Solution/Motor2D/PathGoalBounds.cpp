@@ -0,0 +1,147 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "PathPolicies.h"
+#include "PathDatabase.h"
+#include "PathGoalBounds.h"
+#include <stdio.h>
+#include <limits.h>
+#include <thread>
+
+typedef GridNeighbours<DefaultSearchPolicy> Neighbours;
+
+GoalBounds::GoalBounds()
+{}
+
+void GoalBounds::CleanUp()
+{
+	boxes.clear();
+	boxes.shrink_to_fit();
+	width = height = 0;
+	map_hash = 0;
+}
+
+bool GoalBounds::IsLoaded() const
+{
+	return boxes.size() != 0;
+}
+
+uint GoalBounds::GetMemoryUsage() const
+{
+	return boxes.size() * sizeof(Box);
+}
+
+// Every target reached from a source grows the box of the move it was reached with
+void GoalBounds::BuildSources(const uchar* map, uint first, uint step)
+{
+	uint tiles = width*height;
+	std::vector<int> cost;
+	std::vector<uchar> first_move;
+	std::vector<std::pair<int, int>> open;
+
+	for (uint source = first; source < tiles; source += step)
+	{
+		if (Neighbours::Walkable(map, width, height, source % width, source / width) == false)
+			continue;
+
+		PathDatabase::FirstMoves(width, height, map, source, cost, first_move, open);
+
+		Box* source_boxes = &boxes[source * GOAL_BOUNDS_DIRECTIONS];
+		for (uint target = 0; target < tiles; ++target)
+		{
+			if (target == source || cost[target] < 0)
+				continue;
+
+			Box& box = source_boxes[first_move[target]];
+			short x = target % width, y = target / width;
+			box.min_x = MIN(box.min_x, x);
+			box.min_y = MIN(box.min_y, y);
+			box.max_x = MAX(box.max_x, x);
+			box.max_y = MAX(box.max_y, y);
+		}
+	}
+}
+
+bool GoalBounds::Build(uint width, uint height, const uchar* map, uint threads)
+{
+	CleanUp();
+
+	// boxes are stored as shorts
+	if (width > SHRT_MAX || height > SHRT_MAX)
+		return false;
+
+	this->width = width;
+	this->height = height;
+	map_hash = PathDatabase::HashMap(width, height, map);
+
+	Box empty = { SHRT_MAX, SHRT_MAX, -1, -1 };
+	boxes.assign(width*height*GOAL_BOUNDS_DIRECTIONS, empty);
+
+	// every thread writes the boxes of its own sources only
+	if (threads == 0)
+		threads = MAX(std::thread::hardware_concurrency(), 1u);
+
+	std::vector<std::thread> workers;
+	for (uint i = 1; i < threads; ++i)
+		workers.push_back(std::thread(&GoalBounds::BuildSources, this, map, i, threads));
+	BuildSources(map, 0, threads);
+
+	for (std::vector<std::thread>::iterator item = workers.begin(); item != workers.end(); ++item)
+		item->join();
+
+	LOG("Goal bounds: %u boxes, %u bytes", boxes.size(), GetMemoryUsage());
+	return true;
+}
+
+bool GoalBounds::Save(const char* path) const
+{
+	if (boxes.size() == 0)
+		return false;
+
+	FILE* output = nullptr;
+	if (fopen_s(&output, path, "wb") != 0 || output == nullptr)
+	{
+		LOG("Could not write goal bounds %s", path);
+		return false;
+	}
+
+	Header header = { { 'G', 'B', 'D', '1' }, GOAL_BOUNDS_VERSION, width, height, map_hash };
+	bool ret = fwrite(&header, sizeof(Header), 1, output) == 1 &&
+		fwrite(boxes.data(), sizeof(Box), boxes.size(), output) == boxes.size();
+	fclose(output);
+	return ret;
+}
+
+bool GoalBounds::Load(const char* path, uint width, uint height, const uchar* map)
+{
+	CleanUp();
+
+	FILE* input = nullptr;
+	if (fopen_s(&input, path, "rb") != 0 || input == nullptr)
+		return false;
+
+	Header header;
+	bool valid = fread(&header, sizeof(Header), 1, input) == 1 &&
+		memcmp(header.magic, "GBD1", 4) == 0 && header.version == GOAL_BOUNDS_VERSION &&
+		header.width == width && header.height == height &&
+		header.map_hash == PathDatabase::HashMap(width, height, map);
+
+	if (valid == true)
+	{
+		boxes.resize(width*height*GOAL_BOUNDS_DIRECTIONS);
+		valid = fread(boxes.data(), sizeof(Box), boxes.size(), input) == boxes.size();
+	}
+	fclose(input);
+
+	if (valid == false)
+	{
+		LOG("Goal bounds %s do not match the current map", path);
+		CleanUp();
+		return false;
+	}
+
+	this->width = width;
+	this->height = height;
+	map_hash = header.map_hash;
+	LOG("Goal bounds %s: %u bytes", path, GetMemoryUsage());
+	return true;
+}
@@ -0,0 +1,92 @@
+#ifndef __PATHGOALBOUNDS_H__
+#define __PATHGOALBOUNDS_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+
+#define GOAL_BOUNDS_VERSION 1
+#define GOAL_BOUNDS_DIRECTIONS 8
+
+// --------------------------------------------------
+// Goal bounding
+// Rabin, Sturtevant: "Combining Bounding Boxes and JPS to Prune Grid Pathfinding"
+// For every tile and outgoing direction a box holds every target whose optimal
+// path starts with that direction. A search only opens a neighbour when its
+// box holds the destination: some optimal path always survives, most of the
+// tiles off the corridor never get on the open list. The boxes take a Dijkstra
+// per tile to build, so they are cached to a file keyed by the map hash.
+// --------------------------------------------------
+
+// ---------------------------------------------------------------------
+// GoalBounds: one box per tile and direction of grid_dirs
+// ---------------------------------------------------------------------
+class GoalBounds
+{
+public:
+
+	GoalBounds();
+
+	// Builds the boxes of a walkability map, threads 0 uses every cpu
+	bool Build(uint width, uint height, const uchar* map, uint threads = 0);
+
+	// Writes the boxes to a cache file
+	bool Save(const char* path) const;
+
+	// Reads a cache file, fails if it was not built for this walkability map
+	bool Load(const char* path, uint width, uint height, const uchar* map);
+
+	// Frees the boxes
+	void CleanUp();
+
+	bool IsLoaded() const;
+
+	// Bit dir is set when the box of that direction from pos holds destination
+	inline uint Directions(const iPoint& pos, const iPoint& destination) const
+	{
+		const Box* box = &boxes[((pos.y * width) + pos.x) * GOAL_BOUNDS_DIRECTIONS];
+		uint ret = 0;
+
+		for (uint dir = 0; dir < GOAL_BOUNDS_DIRECTIONS; ++dir, ++box)
+		{
+			if (destination.x >= box->min_x && destination.x <= box->max_x &&
+				destination.y >= box->min_y && destination.y <= box->max_y)
+				ret |= (1 << dir);
+		}
+
+		return ret;
+	}
+
+	uint GetMemoryUsage() const;
+
+private:
+
+	// an empty box has min > max
+	struct Box
+	{
+		short min_x;
+		short min_y;
+		short max_x;
+		short max_y;
+	};
+
+	struct Header
+	{
+		char magic[4];
+		uint32 version;
+		uint32 width;
+		uint32 height;
+		uint32 map_hash;
+	};
+
+	void BuildSources(const uchar* map, uint first, uint step);
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	uint32 map_hash = 0;
+	std::vector<Box> boxes;
+};
+
+#endif // __PATHGOALBOUNDS_H__
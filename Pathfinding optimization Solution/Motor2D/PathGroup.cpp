@@ -0,0 +1,260 @@
+#include "p2Defs.h"
+#include "j1App.h"
+#include "j1PathFinding.h"
+#include "PathGroup.h"
+#include <math.h>
+
+typedef GridNeighbours<DefaultSearchPolicy> Neighbours;
+
+GroupPlanner::GroupPlanner()
+{}
+
+void GroupPlanner::SetSpacing(uint tiles)
+{
+	spacing = MAX(tiles, 1);
+}
+
+void GroupPlanner::SetLocalExpansions(uint nodes)
+{
+	local_expansions = MAX(nodes, 1);
+}
+
+iPoint GroupPlanner::LeaderOrigin(const uchar* map, uint width, uint height, const std::vector<iPoint>& units) const
+{
+	iPoint centroid(0, 0);
+	for (uint i = 0; i < units.size(); ++i)
+		centroid += units[i];
+	centroid.x /= (int)units.size();
+	centroid.y /= (int)units.size();
+
+	if (Neighbours::Walkable(map, width, height, centroid.x, centroid.y) == true)
+		return centroid;
+
+	uint closest = 0;
+	for (uint i = 1; i < units.size(); ++i)
+	{
+		if (DefaultSearchPolicy::H(units[i], centroid) < DefaultSearchPolicy::H(units[closest], centroid))
+			closest = i;
+	}
+
+	return units[closest];
+}
+
+// ----------------------------------------------------------------------------------
+// Units are sorted top to bottom, cut into rows as wide as the formation and each
+// row sorted left to right, slot k of that order goes to the k-th unit. The leader
+// stands in the middle slot
+// ----------------------------------------------------------------------------------
+void GroupPlanner::AssignSlots(const std::vector<iPoint>& units)
+{
+	uint count = units.size();
+	uint columns = (uint)ceil(sqrt((double)count));
+	uint rows = (count + columns - 1) / columns;
+
+	order.resize(count);
+	for (uint i = 0; i < count; ++i)
+		order[i] = i;
+
+	std::sort(order.begin(), order.end(), [&](uint a, uint b)
+	{
+		return units[a].y < units[b].y || (units[a].y == units[b].y && units[a].x < units[b].x);
+	});
+
+	for (uint row = 0; row * columns < count; ++row)
+	{
+		std::sort(order.begin() + row * columns, order.begin() + MIN((row + 1) * columns, count), [&](uint a, uint b)
+		{
+			return units[a].x < units[b].x;
+		});
+	}
+
+	offsets.resize(count);
+	for (uint k = 0; k < count; ++k)
+	{
+		int column = k % columns, row = k / columns;
+		offsets[order[k]].create((column - (int)(columns - 1) / 2) * (int)spacing, (row - (int)(rows - 1) / 2) * (int)spacing);
+	}
+}
+
+// Square rings around the slot from the inside out
+bool GroupPlanner::FindSlotTile(const uchar* map, uint width, uint height, const iPoint& slot, iPoint& tile) const
+{
+	auto test = [&](int x, int y)
+	{
+		if (Neighbours::Walkable(map, width, height, x, y) == false)
+			return false;
+
+		tile.create(x, y);
+		return std::find(claimed.begin(), claimed.end(), tile) == claimed.end();
+	};
+
+	int max_radius = MAX(MAX(abs(slot.x), abs((int)width - 1 - slot.x)), MAX(abs(slot.y), abs((int)height - 1 - slot.y)));
+	if (test(slot.x, slot.y) == true)
+		return true;
+
+	for (int r = 1; r <= max_radius; ++r)
+	{
+		for (int i = -r; i <= r; ++i)
+		{
+			if (test(slot.x + i, slot.y - r) == true || test(slot.x + i, slot.y + r) == true)
+				return true;
+		}
+		for (int i = -r + 1; i < r; ++i)
+		{
+			if (test(slot.x - r, slot.y + i) == true || test(slot.x + r, slot.y + i) == true)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+// Shared A* that stops once it has expanded the cap
+struct CappedHooks : public SearchHooks<DefaultSearchPolicy>
+{
+	CappedHooks(uint cap, GroupStats& stats) : left(cap), stats(stats)
+	{}
+
+	inline bool Expand(const PathNode*)
+	{
+		if (left == 0)
+			return false;
+
+		left--;
+		stats.local_expansions++;
+		return true;
+	}
+
+	uint left;
+	GroupStats& stats;
+};
+
+bool GroupPlanner::LocalSearch(SearchContext& context, const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path,
+	GroupStats& stats)
+{
+	stats.local_searches++;
+
+	CappedHooks hooks(local_expansions, stats);
+	if (App->pathfinding->FindPath<DefaultSearchPolicy>(context, origin, destination, piece, hooks) == false)
+		return false;
+
+	path.insert(path.end(), piece.begin() + 1, piece.end());
+	return true;
+}
+
+bool GroupPlanner::Reach(SearchContext& context, const iPoint& destination, std::vector<iPoint>& path, GroupStats& stats)
+{
+	if (LocalSearch(context, path.back(), destination, path, stats) == true)
+		return true;
+
+	stats.full_searches++;
+	if (App->pathfinding->FindPathLanes(context, path.back(), destination, piece) == false)
+		return false;
+
+	path.insert(path.end(), piece.begin() + 1, piece.end());
+	return true;
+}
+
+// A repeated tile drops everything after its first visit, the steps around the cut
+// were both taken from that tile so the path stays connected
+void GroupPlanner::RemoveLoops(std::vector<iPoint>& path, uint width)
+{
+	++stamp;
+	uint size = 0;
+
+	for (uint k = 0; k < path.size(); ++k)
+	{
+		iPoint tile = path[k];
+		uint index = (tile.y * width) + tile.x;
+
+		if (seen_stamps[index] == stamp && seen[index] < size && path[seen[index]] == tile)
+		{
+			size = seen[index] + 1;
+			continue;
+		}
+
+		seen_stamps[index] = stamp;
+		seen[index] = size;
+		path[size++] = tile;
+	}
+
+	path.resize(size);
+}
+
+// ----------------------------------------------------------------------------------
+// A unit joins its shifted path at the tile closest to it, so units ahead of the
+// leader don't walk back and the first correction stays short. Blocked
+// shifted tiles are skipped and the gap is bridged by a correction; a correction
+// that fails between two shifted tiles sends the unit straight to its slot
+// ----------------------------------------------------------------------------------
+void GroupPlanner::Plan(SearchContext& context, const uchar* map, uint width, uint height, const std::vector<iPoint>& leader,
+	const std::vector<iPoint>& units, std::vector<std::vector<iPoint>*>& paths, GroupStats& stats)
+{
+	AssignSlots(units);
+	claimed.clear();
+
+	if (seen.size() < width * height)
+	{
+		seen.resize(width * height);
+		seen_stamps.assign(width * height, 0);
+		stamp = 0;
+	}
+
+	for (uint i = 0; i < units.size(); ++i)
+	{
+		std::vector<iPoint>& path = *paths[i];
+		const iPoint& offset = offsets[i];
+		path.clear();
+
+		iPoint goal;
+		if (Neighbours::Walkable(map, width, height, units[i].x, units[i].y) == false ||
+			FindSlotTile(map, width, height, leader.back() + offset, goal) == false)
+			continue;
+		claimed.push_back(goal);
+
+		uint join = leader.size() - 1;
+		int best = DefaultSearchPolicy::H(units[i], goal);
+		for (uint j = 0; j + 1 < leader.size(); ++j)
+		{
+			iPoint tile = leader[j] + offset;
+			int distance = DefaultSearchPolicy::H(units[i], tile);
+			if (distance < best && Neighbours::Walkable(map, width, height, tile.x, tile.y) == true)
+			{
+				best = distance;
+				join = j;
+			}
+		}
+
+		path.push_back(units[i]);
+		for (uint j = join; j < leader.size(); ++j)
+		{
+			iPoint tile = (j + 1 == leader.size()) ? goal : leader[j] + offset;
+			iPoint from = path.back();
+			if (tile == from || Neighbours::Walkable(map, width, height, tile.x, tile.y) == false)
+				continue;
+
+			// a free step when the shifted tiles are neighbours and the step is legal
+			bool step = false;
+			for (uint dir = 0; dir < 8 && step == false; ++dir)
+			{
+				if (from.x + grid_dirs[dir][0] == tile.x && from.y + grid_dirs[dir][1] == tile.y)
+					step = Neighbours::Step(map, width, height, from.x, from.y, dir) != 0;
+			}
+
+			if (step == true)
+			{
+				path.push_back(tile);
+			}
+			else if (tile == goal || LocalSearch(context, from, tile, path, stats) == false)
+			{
+				Reach(context, goal, path, stats);
+				break;
+			}
+		}
+
+		if (path.back() != goal)
+			path.clear();
+		else
+			RemoveLoops(path, width);
+	}
+}
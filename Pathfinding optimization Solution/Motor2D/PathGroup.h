@@ -0,0 +1,92 @@
+#ifndef __PATHGROUP_H__
+#define __PATHGROUP_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+
+// tiles between formation slots and nodes a correction may expand
+#define DEFAULT_GROUP_SPACING 1
+#define DEFAULT_GROUP_LOCAL_EXPANSIONS 256
+
+// --------------------------------------------------
+// Group move orders
+// Reynolds: "Steering Behaviors For Autonomous Characters" (leader following)
+// A group order searches one leader path from the centroid of the units and
+// gives every unit a slot of a formation around it. A unit follows the leader
+// path shifted by its slot: shifted tiles are free as long as they are
+// walkable and the steps between them legal. Only where they are not does the
+// unit get a small A* capped in expansions, from the last good tile to the
+// next walkable one, plus one to reach its first shifted tile. Loops a bridge
+// makes over tiles the unit already walked are cut. Units are laid into slots
+// by rows the way they stand, so paths don't cross. A correction that hits
+// its cap falls back to a full search to the slot.
+// --------------------------------------------------
+class SearchContext;
+
+// ---------------------------------------------------------------------
+// GroupStats: searches made by the last group order
+// ---------------------------------------------------------------------
+struct GroupStats
+{
+	// leader plus fallbacks
+	uint full_searches = 0;
+	uint local_searches = 0;
+	uint local_expansions = 0;
+};
+
+// ---------------------------------------------------------------------
+// GroupPlanner: formation slots and the paths that follow the leader
+// ---------------------------------------------------------------------
+class GroupPlanner
+{
+public:
+
+	GroupPlanner();
+
+	void SetSpacing(uint tiles);
+	void SetLocalExpansions(uint nodes);
+
+	// Tile the leader path starts from: the centroid, or the unit closest to it
+	// when the centroid is blocked
+	iPoint LeaderOrigin(const uchar* map, uint width, uint height, const std::vector<iPoint>& units) const;
+
+	// Fills paths[i] for units[i] along the leader path, an empty path if the unit
+	// can't reach its slot
+	void Plan(SearchContext& context, const uchar* map, uint width, uint height, const std::vector<iPoint>& leader,
+		const std::vector<iPoint>& units, std::vector<std::vector<iPoint>*>& paths, GroupStats& stats);
+
+private:
+
+	// Offset of every unit from the leader, rows kept in the order they stand
+	void AssignSlots(const std::vector<iPoint>& units);
+
+	// Free tile closest to a slot that no other unit ends on
+	bool FindSlotTile(const uchar* map, uint width, uint height, const iPoint& slot, iPoint& tile) const;
+
+	// A* that gives up after the expansion cap, appends to path without its first tile
+	bool LocalSearch(SearchContext& context, const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path,
+		GroupStats& stats);
+
+	// Cuts the detours where a path comes back to a tile it already went through
+	void RemoveLoops(std::vector<iPoint>& path, uint width);
+
+	// Correction first, full search when it hits the cap
+	bool Reach(SearchContext& context, const iPoint& destination, std::vector<iPoint>& path, GroupStats& stats);
+
+private:
+
+	uint spacing = DEFAULT_GROUP_SPACING;
+	uint local_expansions = DEFAULT_GROUP_LOCAL_EXPANSIONS;
+	// scratch for the order being planned
+	std::vector<iPoint> offsets;
+	std::vector<uint> order;
+	std::vector<iPoint> claimed;
+	std::vector<iPoint> piece;
+	// path index of every tile the current path went through, valid for this stamp
+	std::vector<uint> seen;
+	std::vector<uint> seen_stamps;
+	uint stamp = 0;
+};
+
+#endif // __PATHGROUP_H__
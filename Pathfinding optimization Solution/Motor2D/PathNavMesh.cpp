@@ -0,0 +1,390 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "PathPolicies.h"
+#include "PathNavMesh.h"
+#include <math.h>
+#include <algorithm>
+#include <functional>
+
+typedef GridNeighbours<DefaultSearchPolicy> Neighbours;
+
+// twice the signed area of a b c, the sign tells the side of c from a b
+static inline int TriArea2(const iPoint& a, const iPoint& b, const iPoint& c)
+{
+	return ((c.x - a.x) * (b.y - a.y)) - ((b.x - a.x) * (c.y - a.y));
+}
+
+// a corner in line with the last segment only extends it, zero width portals of
+// one tile corridors put every portal end on that line
+static inline void AddCorner(std::vector<iPoint>& path, const iPoint& corner)
+{
+	if (path.back() == corner)
+		return;
+
+	uint size = path.size();
+	if (size > 1)
+	{
+		const iPoint& a = path[size - 2];
+		const iPoint& b = path[size - 1];
+		if (TriArea2(a, b, corner) == 0 && ((b.x - a.x) * (corner.x - b.x)) + ((b.y - a.y) * (corner.y - b.y)) >= 0)
+		{
+			path.back() = corner;
+			return;
+		}
+	}
+
+	path.push_back(corner);
+}
+
+static inline float Distance(const iPoint& a, const iPoint& b)
+{
+	float dx = (float)(b.x - a.x), dy = (float)(b.y - a.y);
+	return sqrtf((dx * dx) + (dy * dy));
+}
+
+NavMesh::NavMesh()
+{}
+
+void NavMesh::SetMap(uint width, uint height, const uchar* map)
+{
+	CleanUp();
+
+	this->width = width;
+	this->height = height;
+	polygon_of.assign(width*height, NAVMESH_NONE);
+
+	std::vector<int> created;
+	Decompose(map, 0, 0, width - 1, height - 1, created);
+	for (std::vector<int>::const_iterator item = created.begin(); item != created.end(); ++item)
+		Relink(*item);
+
+	LOG("Navmesh: %u polygons over %u tiles", GetPolygonCount(), width*height);
+}
+
+void NavMesh::CleanUp()
+{
+	polygon_of.clear();
+	polygons.clear();
+	links.clear();
+	free_polygons.clear();
+	width = height = 0;
+}
+
+uint NavMesh::GetPolygonCount() const
+{
+	return polygons.size() - free_polygons.size();
+}
+
+int NavMesh::NewPolygon(int x, int y, int w, int h)
+{
+	Polygon polygon = { x, y, w, h };
+	int id;
+
+	if (free_polygons.size() != 0)
+	{
+		id = free_polygons.back();
+		free_polygons.pop_back();
+		polygons[id] = polygon;
+	}
+	else
+	{
+		id = polygons.size();
+		polygons.push_back(polygon);
+		links.push_back(std::vector<Link>());
+	}
+
+	for (int j = y; j < y + h; ++j)
+		std::fill(polygon_of.begin() + (j * width) + x, polygon_of.begin() + (j * width) + x + w, id);
+
+	return id;
+}
+
+// Greedy split of the walkable tiles in [x0, x1] x [y0, y1], rectangles grow right and down in turns
+void NavMesh::Decompose(const uchar* map, int x0, int y0, int x1, int y1, std::vector<int>& created)
+{
+	auto free_tile = [&](int x, int y)
+	{
+		return polygon_of[(y * width) + x] == NAVMESH_NONE && Neighbours::Walkable(map, width, height, x, y);
+	};
+
+	for (int y = y0; y <= y1; ++y)
+	{
+		for (int x = x0; x <= x1; ++x)
+		{
+			if (free_tile(x, y) == false)
+				continue;
+
+			int w = 1, h = 1;
+			bool grow_w = true, grow_h = true;
+			while (grow_w == true || grow_h == true)
+			{
+				if (grow_w == true)
+				{
+					grow_w = (x + w <= x1);
+					for (int j = 0; j < h && grow_w == true; ++j)
+						grow_w = free_tile(x + w, y + j);
+
+					if (grow_w == true)
+						w++;
+				}
+
+				if (grow_h == true)
+				{
+					grow_h = (y + h <= y1);
+					for (int i = 0; i < w && grow_h == true; ++i)
+						grow_h = free_tile(x + i, y + h);
+
+					if (grow_h == true)
+						h++;
+				}
+			}
+
+			created.push_back(NewPolygon(x, y, w, h));
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------------
+// Portals of a polygon: every run of outside tiles along one of its sides that
+// belongs to the same polygon. Polygons only touching at a corner are not linked,
+// a diagonal step there always has a walkable side tile in a third polygon
+// ----------------------------------------------------------------------------------
+void NavMesh::Relink(int id)
+{
+	const Polygon& polygon = polygons[id];
+	std::vector<Link>& polygon_links = links[id];
+	polygon_links.clear();
+
+	// inside: first tile on the side, outward: step to the neighbour, along: direction of the side
+	auto side = [&](const iPoint& inside, const iPoint& outward, const iPoint& along, int length)
+	{
+		iPoint outside(inside.x + outward.x, inside.y + outward.y);
+		if (outside.x < 0 || outside.y < 0 || outside.x >= (int)width || outside.y >= (int)height)
+			return;
+
+		int run_start = 0;
+		for (int i = 0; i <= length; ++i)
+		{
+			int current = (i < length) ? polygon_of[((outside.y + along.y * i) * width) + outside.x + along.x * i] : NAVMESH_NONE;
+			int previous = (i > 0) ? polygon_of[((outside.y + along.y * (i - 1)) * width) + outside.x + along.x * (i - 1)] : NAVMESH_NONE;
+
+			if (i > 0 && current != previous && previous != NAVMESH_NONE)
+			{
+				Link link;
+				link.polygon = previous;
+				link.a0.create(inside.x + along.x * run_start, inside.y + along.y * run_start);
+				link.a1.create(inside.x + along.x * (i - 1), inside.y + along.y * (i - 1));
+				link.b0.create(link.a0.x + outward.x, link.a0.y + outward.y);
+				link.b1.create(link.a1.x + outward.x, link.a1.y + outward.y);
+				polygon_links.push_back(link);
+			}
+
+			if (current != previous)
+				run_start = i;
+		}
+	};
+
+	int right = polygon.x + polygon.w - 1, bottom = polygon.y + polygon.h - 1;
+	side(iPoint(polygon.x, polygon.y), iPoint(0, -1), iPoint(1, 0), polygon.w);
+	side(iPoint(polygon.x, bottom), iPoint(0, 1), iPoint(1, 0), polygon.w);
+	side(iPoint(polygon.x, polygon.y), iPoint(-1, 0), iPoint(0, 1), polygon.h);
+	side(iPoint(right, polygon.y), iPoint(1, 0), iPoint(0, 1), polygon.h);
+}
+
+// The polygon that held the tile is split again. New polygons and every polygon
+// that bordered the old one or borders a new one get their portals rebuilt
+void NavMesh::SetTile(const iPoint& pos, const uchar* map)
+{
+	if (polygon_of.size() == 0)
+		return;
+
+	std::vector<int> created, touched;
+	int id = polygon_of[(pos.y * width) + pos.x];
+
+	if (id != NAVMESH_NONE)
+	{
+		Polygon polygon = polygons[id];
+		for (std::vector<Link>::const_iterator item = links[id].begin(); item != links[id].end(); ++item)
+			touched.push_back(item->polygon);
+
+		for (int j = polygon.y; j < polygon.y + polygon.h; ++j)
+			std::fill(polygon_of.begin() + (j * width) + polygon.x, polygon_of.begin() + (j * width) + polygon.x + polygon.w, NAVMESH_NONE);
+
+		links[id].clear();
+		free_polygons.push_back(id);
+		Decompose(map, polygon.x, polygon.y, polygon.x + polygon.w - 1, polygon.y + polygon.h - 1, created);
+	}
+
+	Decompose(map, pos.x, pos.y, pos.x, pos.y, created);
+
+	for (std::vector<int>::const_iterator item = created.begin(); item != created.end(); ++item)
+	{
+		Relink(*item);
+		for (std::vector<Link>::const_iterator link = links[*item].begin(); link != links[*item].end(); ++link)
+			touched.push_back(link->polygon);
+	}
+
+	std::sort(touched.begin(), touched.end());
+	touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+	for (std::vector<int>::const_iterator item = touched.begin(); item != touched.end(); ++item)
+	{
+		if (std::find(free_polygons.begin(), free_polygons.end(), *item) == free_polygons.end())
+			Relink(*item);
+	}
+}
+
+// ----------------------------------------------------------------------------------
+// A* over polygons: a polygon is reached at the middle of its portal and scored
+// with straight distances. The funnel then straightens the portal corridor
+// ----------------------------------------------------------------------------------
+bool NavMesh::FindPath(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const
+{
+	typedef std::pair<float, int> Entry;
+
+	if (polygon_of.size() == 0 ||
+		origin.x < 0 || origin.y < 0 || origin.x >= (int)width || origin.y >= (int)height ||
+		destination.x < 0 || destination.y < 0 || destination.x >= (int)width || destination.y >= (int)height)
+		return false;
+
+	int first = polygon_of[(origin.y * width) + origin.x];
+	int goal = polygon_of[(destination.y * width) + destination.x];
+	if (first == NAVMESH_NONE || goal == NAVMESH_NONE)
+		return false;
+
+	uint count = polygons.size();
+	std::vector<float> g(count, -1.0f);
+	std::vector<const Link*> came_through(count, nullptr);
+	std::vector<int> came_from(count, NAVMESH_NONE);
+	std::vector<iPoint> entry(count);
+	std::vector<bool> closed(count, false);
+	std::vector<Entry> open;
+
+	g[first] = 0.0f;
+	entry[first] = origin;
+	open.push_back(Entry(Distance(origin, destination), first));
+
+	while (open.size() != 0)
+	{
+		std::pop_heap(open.begin(), open.end(), std::greater<Entry>());
+		int current = open.back().second;
+		open.pop_back();
+
+		if (closed[current] == true)
+			continue;
+		closed[current] = true;
+
+		if (current == goal)
+			break;
+
+		for (std::vector<Link>::const_iterator link = links[current].begin(); link != links[current].end(); ++link)
+		{
+			if (closed[link->polygon] == true)
+				continue;
+
+			iPoint middle((link->b0.x + link->b1.x) / 2, (link->b0.y + link->b1.y) / 2);
+			float new_g = g[current] + Distance(entry[current], middle);
+			if (g[link->polygon] >= 0.0f && new_g >= g[link->polygon])
+				continue;
+
+			g[link->polygon] = new_g;
+			came_from[link->polygon] = current;
+			came_through[link->polygon] = &(*link);
+			entry[link->polygon] = middle;
+			open.push_back(Entry(new_g + Distance(middle, destination), link->polygon));
+			std::push_heap(open.begin(), open.end(), std::greater<Entry>());
+		}
+	}
+
+	if (closed[goal] == false)
+		return false;
+
+	// portals from the goal back, each link gives the two portals of its shared edge
+	std::vector<const Link*> corridor;
+	for (int polygon = goal; came_through[polygon] != nullptr; polygon = came_from[polygon])
+		corridor.push_back(came_through[polygon]);
+	std::reverse(corridor.begin(), corridor.end());
+
+	std::vector<iPoint> lefts(1, origin), rights(1, origin);
+	for (std::vector<const Link*>::const_iterator item = corridor.begin(); item != corridor.end(); ++item)
+	{
+		const Link* link = *item;
+		iPoint outward(link->b0.x - link->a0.x, link->b0.y - link->a0.y);
+		// which end is on the left looking along outward, y grows down
+		bool a0_left = ((outward.x * (link->a0.y - link->a1.y)) - (outward.y * (link->a0.x - link->a1.x))) > 0;
+
+		lefts.push_back(a0_left ? link->a0 : link->a1);
+		rights.push_back(a0_left ? link->a1 : link->a0);
+		lefts.push_back(a0_left ? link->b0 : link->b1);
+		rights.push_back(a0_left ? link->b1 : link->b0);
+	}
+	lefts.push_back(destination);
+	rights.push_back(destination);
+
+	Funnel(lefts, rights, path_to_fill);
+	return true;
+}
+
+// ----------------------------------------------------------------------------------
+// Simple stupid funnel: the apex keeps the tightest left and right portal ends in
+// sight, when one side crosses the other the crossed end becomes a corner. Corners
+// in line with the previous segment are merged into it
+// ----------------------------------------------------------------------------------
+void NavMesh::Funnel(const std::vector<iPoint>& lefts, const std::vector<iPoint>& rights, std::vector<iPoint>& path_to_fill) const
+{
+	path_to_fill.clear();
+
+	iPoint apex = lefts[0], left = lefts[0], right = rights[0];
+	uint apex_index = 0, left_index = 0, right_index = 0;
+	path_to_fill.push_back(apex);
+
+	for (uint i = 1; i < lefts.size(); ++i)
+	{
+		const iPoint& next_left = lefts[i];
+		const iPoint& next_right = rights[i];
+
+		// tighten the right side
+		if (TriArea2(apex, right, next_right) <= 0)
+		{
+			if (apex == right || TriArea2(apex, left, next_right) > 0)
+			{
+				right = next_right;
+				right_index = i;
+			}
+			else
+			{
+				// right crossed over left, left is a corner
+				apex = left;
+				apex_index = left_index;
+				AddCorner(path_to_fill, apex);
+
+				left = right = apex;
+				left_index = right_index = apex_index;
+				i = apex_index;
+				continue;
+			}
+		}
+
+		// tighten the left side
+		if (TriArea2(apex, left, next_left) >= 0)
+		{
+			if (apex == left || TriArea2(apex, right, next_left) < 0)
+			{
+				left = next_left;
+				left_index = i;
+			}
+			else
+			{
+				apex = right;
+				apex_index = right_index;
+				AddCorner(path_to_fill, apex);
+
+				left = right = apex;
+				left_index = right_index = apex_index;
+				i = apex_index;
+				continue;
+			}
+		}
+	}
+
+	AddCorner(path_to_fill, lefts.back());
+}
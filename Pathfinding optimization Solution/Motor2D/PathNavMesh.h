@@ -0,0 +1,74 @@
+#ifndef __PATHNAVMESH_H__
+#define __PATHNAVMESH_H__
+
+#include "p2Point.h"
+#include <vector>
+
+#define NAVMESH_NONE -1
+
+// --------------------------------------------------
+// Navigation mesh over the tile grid
+// Walkable tiles are merged into rectangles, the simplest convex polygons a grid
+// gives. Polygons are taken between tile centres, so two neighbours are joined
+// by a pair of portals, one on each side of the shared edge. Queries run A* over
+// the polygons and pull the corridor tight with the simple stupid funnel
+// algorithm (Mononen), the path is a list of tiles with walkable straight lines
+// between them.
+// --------------------------------------------------
+
+// ---------------------------------------------------------------------
+// NavMesh: polygons, their portals and the polygon search
+// ---------------------------------------------------------------------
+class NavMesh
+{
+public:
+
+	NavMesh();
+
+	// Merges every walkable tile of the map into polygons
+	void SetMap(uint width, uint height, const uchar* map);
+
+	// Releases the polygons
+	void CleanUp();
+
+	// A tile changed: its polygon is split again and only the polygons around it relinked
+	void SetTile(const iPoint& pos, const uchar* map);
+
+	// Polygon A* and funnel, path_to_fill gets the waypoints
+	bool FindPath(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const;
+
+	// Number of polygons in use
+	uint GetPolygonCount() const;
+
+private:
+
+	struct Polygon
+	{
+		int x, y, w, h;
+	};
+
+	// portal a0-a1 on the edge of this polygon, b0-b1 on the edge of the next one
+	struct Link
+	{
+		int polygon;
+		iPoint a0, a1;
+		iPoint b0, b1;
+	};
+
+	void Decompose(const uchar* map, int x0, int y0, int x1, int y1, std::vector<int>& created);
+	int NewPolygon(int x, int y, int w, int h);
+	void Relink(int id);
+	void Funnel(const std::vector<iPoint>& lefts, const std::vector<iPoint>& rights, std::vector<iPoint>& path_to_fill) const;
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	// polygon of every tile, NAVMESH_NONE for unwalkable ones
+	std::vector<int> polygon_of;
+	std::vector<Polygon> polygons;
+	std::vector<std::vector<Link>> links;
+	std::vector<int> free_polygons;
+};
+
+#endif // __PATHNAVMESH_H__
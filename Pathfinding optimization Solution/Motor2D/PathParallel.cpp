@@ -0,0 +1,315 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "j1App.h"
+#include "j1PathFinding.h"
+#include "PathParallel.h"
+#include <thread>
+#include <new>
+#include <malloc.h>
+#include <limits.h>
+
+#define PARALLEL_NO_COST INT_MAX
+#define PARALLEL_CACHE_LINE 64
+
+// The inbox other threads push to and the block only its owner touches start on
+// cache lines of their own, so two threads never write the same line. new doesn't
+// align past 16 bytes on this toolset, workers take their memory aligned
+struct ParallelSearch::Worker
+{
+	static void* operator new(size_t size)
+	{
+		void* memory = _aligned_malloc(size, PARALLEL_CACHE_LINE);
+		if (memory == nullptr)
+			throw std::bad_alloc();
+		return memory;
+	}
+
+	static void operator delete(void* memory)
+	{
+		_aligned_free(memory);
+	}
+
+	alignas(PARALLEL_CACHE_LINE) std::atomic<Batch*> inbox;
+	alignas(PARALLEL_CACHE_LINE) std::vector<OpenEntry> open;
+	// messages generated for every other thread since the last flush
+	std::vector<std::vector<Message>> outgoing;
+	uint expanded;
+};
+
+struct OpenEntryCompare
+{
+	template<class Entry>
+	bool operator()(const Entry& l, const Entry& r) const
+	{
+		return (l.f != r.f) ? (l.f > r.f) : (l.g < r.g);
+	}
+};
+
+ParallelSearch::ParallelSearch()
+{
+	incumbent = PARALLEL_NO_COST;
+	work = 0;
+}
+
+// Destructor
+ParallelSearch::~ParallelSearch()
+{
+	CleanUp();
+}
+
+void ParallelSearch::SetMap(uint width, uint height)
+{
+	CleanUp();
+
+	this->width = width;
+	this->height = height;
+	blocks_width = (width >> PARALLEL_BLOCK_SHIFT) + 1;
+}
+
+void ParallelSearch::CleanUp()
+{
+	for (std::vector<Worker*>::iterator item = workers.begin(); item != workers.end(); ++item)
+		RELEASE(*item);
+	workers.clear();
+
+	g.clear();
+	g.shrink_to_fit();
+	parent.clear();
+	parent.shrink_to_fit();
+	stamps.clear();
+	stamps.shrink_to_fit();
+	stamp = 0;
+	width = height = blocks_width = last_expansions = 0;
+}
+
+void ParallelSearch::SetThreads(uint threads)
+{
+	this->threads = threads;
+}
+
+uint ParallelSearch::GetLastExpansions() const
+{
+	return last_expansions;
+}
+
+// Lock-free push, the owner takes the whole stack at once so there is no ABA
+void ParallelSearch::Send(uint to, Batch* batch)
+{
+	work += batch->messages.size();
+
+	std::atomic<Batch*>& inbox = workers[to]->inbox;
+	batch->next = inbox.load();
+	while (inbox.compare_exchange_weak(batch->next, batch) == false)
+	{}
+}
+
+void ParallelSearch::Flush(Worker& worker)
+{
+	for (uint to = 0; to < workers.size(); ++to)
+	{
+		if (worker.outgoing[to].size() == 0)
+			continue;
+
+		Batch* batch = new Batch();
+		batch->messages.swap(worker.outgoing[to]);
+		Send(to, batch);
+	}
+}
+
+// A tile of this thread got a new g, the goal lowers the incumbent instead of being opened
+void ParallelSearch::Accept(Worker& worker, const Message& message)
+{
+	int tile = message.tile;
+	if (stamps[tile] != stamp)
+	{
+		stamps[tile] = stamp;
+		g[tile] = PARALLEL_NO_COST;
+	}
+
+	if (message.g >= g[tile])
+		return;
+
+	g[tile] = message.g;
+	parent[tile] = message.parent;
+
+	if (tile == goal)
+	{
+		int best = incumbent.load();
+		while (message.g < best && incumbent.compare_exchange_weak(best, message.g) == false)
+		{}
+		return;
+	}
+
+	OpenEntry entry = { message.g + DefaultSearchPolicy::H(iPoint(tile % width, tile / width), destination), message.g, tile };
+	if (entry.f >= incumbent.load())
+		return;
+
+	worker.open.push_back(entry);
+	std::push_heap(worker.open.begin(), worker.open.end(), OpenEntryCompare());
+}
+
+// ----------------------------------------------------------------------------------
+// A thread is busy while it holds a node worth expanding. It counts itself in work
+// before taking messages in and only takes the messages out once they are in its
+// open list, so work never drops to 0 while anything can still be expanded
+// ----------------------------------------------------------------------------------
+void ParallelSearch::Run(uint id)
+{
+	Worker& self = *workers[id];
+	bool busy = false;
+
+	while (true)
+	{
+		Batch* batch = self.inbox.exchange(nullptr);
+		if (batch != nullptr)
+		{
+			if (busy == false)
+			{
+				busy = true;
+				work++;
+			}
+
+			int received = 0;
+			while (batch != nullptr)
+			{
+				for (std::vector<Message>::const_iterator item = batch->messages.begin(); item != batch->messages.end(); ++item)
+					Accept(self, *item);
+
+				received += batch->messages.size();
+				Batch* next = batch->next;
+				RELEASE(batch);
+				batch = next;
+			}
+			work -= received;
+		}
+
+		if (busy == false)
+		{
+			if (work.load() == 0)
+				break;
+
+			std::this_thread::yield();
+			continue;
+		}
+
+		for (uint i = 0; i < PARALLEL_EXPANSIONS_PER_POLL && self.open.size() != 0; ++i)
+		{
+			OpenEntry current = self.open.front();
+			if (current.f >= incumbent.load())
+				break;
+
+			std::pop_heap(self.open.begin(), self.open.end(), OpenEntryCompare());
+			self.open.pop_back();
+
+			// a better g arrived after this entry was pushed
+			if (current.g != g[current.tile])
+				continue;
+
+			self.expanded++;
+			int x = current.tile % width, y = current.tile / width;
+			auto visit = [&](int nx, int ny, int cost)
+			{
+				Message message = { (ny * (int)width) + nx, current.g + cost, current.tile };
+				if (message.g + DefaultSearchPolicy::H(iPoint(nx, ny), destination) >= incumbent.load())
+					return;
+
+				uint owner = Owner(message.tile);
+				if (owner == id)
+					Accept(self, message);
+				else
+					self.outgoing[owner].push_back(message);
+			};
+			GridNeighbours<DefaultSearchPolicy>::Expand(map, width, height, x, y, visit);
+		}
+
+		Flush(self);
+
+		if (self.open.size() == 0 || self.open.front().f >= incumbent.load())
+		{
+			busy = false;
+			work--;
+		}
+	}
+}
+
+bool ParallelSearch::FindPath(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill)
+{
+	last_expansions = 0;
+
+	if (width == 0 || App->pathfinding->IsWalkable(origin) == false || App->pathfinding->IsWalkable(destination) == false)
+		return false;
+
+	uint map_width, map_height;
+	map = App->pathfinding->GetWalkabilityMap(map_width, map_height);
+
+	if (stamps.size() != width*height)
+	{
+		g.resize(width*height);
+		parent.resize(width*height);
+		stamps.assign(width*height, 0);
+		stamp = 0;
+	}
+	stamp++;
+
+	uint count = (threads != 0) ? threads : MAX(std::thread::hardware_concurrency(), 1u);
+	if (workers.size() != count)
+	{
+		for (std::vector<Worker*>::iterator item = workers.begin(); item != workers.end(); ++item)
+			RELEASE(*item);
+		workers.clear();
+
+		for (uint i = 0; i < count; ++i)
+		{
+			Worker* worker = new Worker();
+			worker->inbox = nullptr;
+			worker->outgoing.resize(count);
+			workers.push_back(worker);
+		}
+	}
+
+	for (std::vector<Worker*>::iterator item = workers.begin(); item != workers.end(); ++item)
+	{
+		(*item)->open.clear();
+		(*item)->expanded = 0;
+	}
+
+	this->destination = destination;
+	goal = (destination.y * width) + destination.x;
+	incumbent = (origin == destination) ? 0 : PARALLEL_NO_COST;
+	work = 0;
+
+	int start = (origin.y * width) + origin.x;
+	if (origin == destination)
+	{
+		stamps[start] = stamp;
+		parent[start] = -1;
+	}
+	else
+	{
+		Batch* batch = new Batch();
+		Message message = { start, 0, -1 };
+		batch->messages.push_back(message);
+		Send(Owner(start), batch);
+
+		std::vector<std::thread> helpers;
+		for (uint i = 1; i < count; ++i)
+			helpers.push_back(std::thread(&ParallelSearch::Run, this, i));
+		Run(0);
+
+		for (std::vector<std::thread>::iterator item = helpers.begin(); item != helpers.end(); ++item)
+			item->join();
+	}
+
+	for (std::vector<Worker*>::iterator item = workers.begin(); item != workers.end(); ++item)
+		last_expansions += (*item)->expanded;
+
+	if (incumbent.load() == PARALLEL_NO_COST)
+		return false;
+
+	path_to_fill.clear();
+	for (int tile = goal; tile != -1; tile = parent[tile])
+		path_to_fill.push_back(iPoint(tile % width, tile / width));
+	std::reverse(path_to_fill.begin(), path_to_fill.end());
+
+	return true;
+}
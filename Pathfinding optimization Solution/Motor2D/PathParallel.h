@@ -0,0 +1,117 @@
+#ifndef __PATHPARALLEL_H__
+#define __PATHPARALLEL_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+#include <atomic>
+
+// search threads, 0 uses every cpu
+#define DEFAULT_PARALLEL_THREADS 0
+// tiles are hashed to threads in squares of 1 << shift tiles a side
+#define PARALLEL_BLOCK_SHIFT 2
+// nodes a thread expands before it sends what it generated and reads its inbox
+#define PARALLEL_EXPANSIONS_PER_POLL 64
+
+// --------------------------------------------------
+// Hash Distributed A* (HDA*)
+// Kishimoto, Fukunaga, Botea: "Scalable, Parallel Best-First Search for Optimal
+// Sequential Planning"
+// Every tile belongs to one thread, picked by hashing the small square it is in.
+// A thread keeps the open list and the g values of its own tiles, a generated
+// tile of another thread is sent to it through a lock-free inbox (a stack the
+// senders push batches onto and the owner takes whole). Nodes are reopened when
+// a better g arrives. Once the goal has a cost, threads stop expanding nodes
+// with f at or above it. The search is over when every thread is idle and no
+// message is in flight: one shared counter holds the busy threads plus the
+// messages sent and not yet taken in, it only reaches 0 when nothing can happen
+// anymore.
+// --------------------------------------------------
+
+// ---------------------------------------------------------------------
+// ParallelSearch: per tile g and parent, and the search threads
+// ---------------------------------------------------------------------
+class ParallelSearch
+{
+public:
+
+	ParallelSearch();
+
+	// Destructor
+	~ParallelSearch();
+
+	// Tiles of a map of this size, the per tile arrays grow on the first search
+	void SetMap(uint width, uint height);
+
+	// Releases the per tile arrays
+	void CleanUp();
+
+	// Threads used by every search, 0 uses every cpu
+	void SetThreads(uint threads);
+
+	// Optimal path searched by every thread at once, the calling thread is one of them
+	bool FindPath(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill);
+
+	// Nodes expanded by all threads in the last search
+	uint GetLastExpansions() const;
+
+private:
+
+	struct Message
+	{
+		int tile;
+		int g;
+		int parent;
+	};
+
+	struct Batch
+	{
+		Batch* next;
+		std::vector<Message> messages;
+	};
+
+	struct OpenEntry
+	{
+		int f;
+		int g;
+		int tile;
+	};
+
+	struct Worker;
+
+	void Run(uint id);
+	void Accept(Worker& worker, const Message& message);
+	void Send(uint to, Batch* batch);
+	void Flush(Worker& worker);
+
+	inline uint Owner(int tile) const
+	{
+		uint x = (tile % width) >> PARALLEL_BLOCK_SHIFT, y = (tile / width) >> PARALLEL_BLOCK_SHIFT;
+		return ((((y * blocks_width) + x) * 2654435761u) >> 16) % workers.size();
+	}
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	uint blocks_width = 0;
+	uint threads = DEFAULT_PARALLEL_THREADS;
+	uint last_expansions = 0;
+
+	// search in progress
+	const uchar* map = nullptr;
+	iPoint destination;
+	int goal = -1;
+	std::atomic<int> incumbent;
+	std::atomic<int> work;
+
+	// written only by the thread owning the tile, valid while stamps matches stamp
+	std::vector<int> g;
+	std::vector<int> parent;
+	std::vector<uint> stamps;
+	uint stamp = 0;
+
+	std::vector<Worker*> workers;
+};
+
+#endif // __PATHPARALLEL_H__
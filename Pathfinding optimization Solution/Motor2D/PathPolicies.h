@@ -0,0 +1,192 @@
+#ifndef __PATHPOLICIES_H__
+#define __PATHPOLICIES_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <stdlib.h>
+
+#define INVALID_WALK_CODE 255
+
+// --------------------------------------------------
+// Compile time rule sets for the grid searches
+// A search policy puts together a neighbourhood, a corner cutting rule, a cost
+// model and a heuristic. Every rule is a static inline function or an enum so
+// each policy compiles into its own kernel without runtime dispatch.
+// --------------------------------------------------
+struct PathNode;
+
+// Neighbourhoods ---------------------------------------------------------------------
+struct FourConnected
+{
+	enum { DIRECTIONS = 4, DIAGONALS = false };
+};
+
+struct EightConnected
+{
+	enum { DIRECTIONS = 8, DIAGONALS = true };
+};
+
+// Corner cutting: can a diagonal step be taken given its two orthogonal tiles ---------
+struct NoCornerCutting
+{
+	static inline bool Allowed(bool side_a, bool side_b) { return side_a && side_b; }
+};
+
+struct CornerCutting
+{
+	// only squeezing between two blocked tiles is forbidden
+	static inline bool Allowed(bool side_a, bool side_b) { return side_a || side_b; }
+};
+
+// Cost models ------------------------------------------------------------------------
+struct OctileCost
+{
+	enum { STRAIGHT = 10, DIAGONAL = 14 };
+};
+
+// diagonals a bit more expensive than their length, paths keep straighter lines
+struct StraightBiasedCost
+{
+	enum { STRAIGHT = 10, DIAGONAL = 16 };
+};
+
+// Heuristics, in the units of the cost model they are used with -----------------------
+struct OctileHeuristic
+{
+	template<class Cost>
+	static inline int Get(int dx, int dy)
+	{
+		return (dx > dy) ? (Cost::DIAGONAL * dy + Cost::STRAIGHT * (dx - dy)) : (Cost::DIAGONAL * dx + Cost::STRAIGHT * (dy - dx));
+	}
+};
+
+// only admissible in four connected grids
+struct ManhattanHeuristic
+{
+	template<class Cost>
+	static inline int Get(int dx, int dy)
+	{
+		return Cost::STRAIGHT * (dx + dy);
+	}
+};
+
+// turns A* into Dijkstra
+struct NullHeuristic
+{
+	template<class Cost>
+	static inline int Get(int, int)
+	{
+		return 0;
+	}
+};
+
+// ---------------------------------------------------------------------
+// SearchPolicy: the full rule set one search kernel is compiled for
+// ---------------------------------------------------------------------
+template<class NEIGHBOURHOOD, class CORNERS, class COST, class HEURISTIC>
+struct SearchPolicy
+{
+	typedef NEIGHBOURHOOD Neighbourhood;
+	typedef CORNERS Corners;
+	typedef COST Cost;
+	typedef HEURISTIC Heuristic;
+
+	static inline int H(const iPoint& from, const iPoint& to)
+	{
+		return Heuristic::template Get<Cost>(abs(to.x - from.x), abs(to.y - from.y));
+	}
+
+	static inline int StepCost(int dx, int dy)
+	{
+		return (dx != 0 && dy != 0) ? Cost::DIAGONAL : Cost::STRAIGHT;
+	}
+};
+
+// rules every search uses unless the caller asks for another policy
+typedef SearchPolicy<EightConnected, NoCornerCutting, OctileCost, OctileHeuristic> DefaultSearchPolicy;
+typedef SearchPolicy<FourConnected, NoCornerCutting, OctileCost, ManhattanHeuristic> FourWaySearchPolicy;
+typedef SearchPolicy<EightConnected, CornerCutting, OctileCost, OctileHeuristic> CornerCuttingSearchPolicy;
+typedef SearchPolicy<EightConnected, NoCornerCutting, StraightBiasedCost, OctileHeuristic> StraightBiasedSearchPolicy;
+typedef SearchPolicy<EightConnected, NoCornerCutting, OctileCost, NullHeuristic> DijkstraSearchPolicy;
+
+// ---------------------------------------------------------------------
+// SearchHooks: what a caller of j1PathFinding::FindPath changes in the
+// search instead of copying it, inlined into the kernel like the policy
+// ---------------------------------------------------------------------
+template<class Policy>
+struct SearchHooks
+{
+	// Heuristic of a tile being opened, a negative one keeps the tile out of the search
+	inline int H(const iPoint& pos, const iPoint& destination) { return Policy::H(pos, destination); }
+
+	// Called before a node is expanded, false stops the search
+	inline bool Expand(const PathNode*) { return true; }
+
+	// Called when the search ends by itself: with the goal node, or nullptr once
+	// every tile the origin reaches is closed
+	inline void Done(const PathNode*) {}
+};
+
+// ---------------------------------------------------------------------
+// GridNeighbours: legal steps out of a tile of a walkability map
+// Directions 0-3 are south, north, east, west and 4-7 the diagonals
+// ---------------------------------------------------------------------
+static const int grid_dirs[8][2] = { { 0, 1 },{ 0, -1 },{ 1, 0 },{ -1, 0 },{ 1, 1 },{ -1, 1 },{ 1, -1 },{ -1, -1 } };
+
+template<class Policy>
+struct GridNeighbours
+{
+	// Utility: same rule as j1PathFinding::IsWalkable over a raw map
+	static inline bool Walkable(const uchar* map, int width, int height, int x, int y)
+	{
+		if (x < 0 || y < 0 || x >= width || y >= height)
+			return false;
+
+		uchar t = map[(y*width) + x];
+		return t != INVALID_WALK_CODE && t > 0;
+	}
+
+	// Single step in direction dir, returns its cost or 0 when it can't be taken
+	static inline int Step(const uchar* map, int width, int height, int x, int y, uint dir)
+	{
+		int dx = grid_dirs[dir][0], dy = grid_dirs[dir][1];
+
+		if (Walkable(map, width, height, x + dx, y + dy) == false)
+			return 0;
+
+		if (dir < 4)
+			return Policy::Cost::STRAIGHT;
+
+		if (Policy::Corners::Allowed(Walkable(map, width, height, x + dx, y), Walkable(map, width, height, x, y + dy)) == false)
+			return 0;
+
+		return Policy::Cost::DIAGONAL;
+	}
+
+	// Calls visit(x, y, cost) for every legal step, each cardinal is only read once
+	template<class Visitor>
+	static inline void Expand(const uchar* map, int width, int height, int x, int y, Visitor& visit)
+	{
+		bool side[4];
+
+		for (uint dir = 0; dir < 4; ++dir)
+		{
+			side[dir] = Walkable(map, width, height, x + grid_dirs[dir][0], y + grid_dirs[dir][1]);
+			if (side[dir])
+				visit(x + grid_dirs[dir][0], y + grid_dirs[dir][1], (int)Policy::Cost::STRAIGHT);
+		}
+
+		if (Policy::Neighbourhood::DIAGONALS)
+		{
+			for (uint dir = 4; dir < 8; ++dir)
+			{
+				int dx = grid_dirs[dir][0], dy = grid_dirs[dir][1];
+
+				if (Policy::Corners::Allowed(side[dy > 0 ? 0 : 1], side[dx > 0 ? 2 : 3]) && Walkable(map, width, height, x + dx, y + dy))
+					visit(x + dx, y + dy, (int)Policy::Cost::DIAGONAL);
+			}
+		}
+	}
+};
+
+#endif // __PATHPOLICIES_H__
@@ -0,0 +1,366 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "PathPolicies.h"
+#include "PathQuadTree.h"
+#include <algorithm>
+#include <functional>
+
+typedef GridNeighbours<DefaultSearchPolicy> Neighbours;
+
+QuadTree::QuadTree()
+{}
+
+void QuadTree::CleanUp()
+{
+	nodes.clear();
+	free_nodes.clear();
+	leaf_of.clear();
+	links.clear();
+	root = QUADTREE_NONE;
+	width = height = leaf_count = 0;
+}
+
+uint QuadTree::GetLeafCount() const
+{
+	return leaf_count;
+}
+
+bool QuadTree::TileWalkable(const uchar* map, int x, int y) const
+{
+	return x < (int)width && y < (int)height && Neighbours::Walkable(map, width, height, x, y);
+}
+
+int QuadTree::NewNode(int x, int y, int size, int parent)
+{
+	Node node = { x, y, size, parent, { QUADTREE_NONE, QUADTREE_NONE, QUADTREE_NONE, QUADTREE_NONE }, false };
+	int id;
+
+	if (free_nodes.size() != 0)
+	{
+		id = free_nodes.back();
+		free_nodes.pop_back();
+		nodes[id] = node;
+		links[id].clear();
+	}
+	else
+	{
+		id = nodes.size();
+		nodes.push_back(node);
+		links.push_back(std::vector<int>());
+	}
+
+	return id;
+}
+
+void QuadTree::FreeNode(int id)
+{
+	links[id].clear();
+	free_nodes.push_back(id);
+}
+
+// Children are built first and collapsed when they are four leaves of the same kind.
+// Squares past the map edge are blocked leaves straight away
+int QuadTree::Build(const uchar* map, int x, int y, int size, int parent)
+{
+	int id = NewNode(x, y, size, parent);
+
+	if (size == 1 || x >= (int)width || y >= (int)height)
+	{
+		nodes[id].walkable = TileWalkable(map, x, y);
+		leaf_count++;
+		return id;
+	}
+
+	int half = size / 2;
+	int children[4];
+	children[0] = Build(map, x, y, half, id);
+	children[1] = Build(map, x + half, y, half, id);
+	children[2] = Build(map, x, y + half, half, id);
+	children[3] = Build(map, x + half, y + half, half, id);
+
+	bool uniform = true;
+	for (uint i = 0; i < 4 && uniform == true; ++i)
+		uniform = nodes[children[i]].children[0] == QUADTREE_NONE && nodes[children[i]].walkable == nodes[children[0]].walkable;
+
+	if (uniform == true)
+	{
+		nodes[id].walkable = nodes[children[0]].walkable;
+		for (uint i = 0; i < 4; ++i)
+			FreeNode(children[i]);
+		leaf_count -= 3;
+	}
+	else
+	{
+		for (uint i = 0; i < 4; ++i)
+			nodes[id].children[i] = children[i];
+	}
+
+	return id;
+}
+
+void QuadTree::SetMap(uint width, uint height, const uchar* map)
+{
+	CleanUp();
+
+	this->width = width;
+	this->height = height;
+	leaf_of.assign(width*height, QUADTREE_NONE);
+
+	int size = 1;
+	while (size < (int)width || size < (int)height)
+		size *= 2;
+
+	root = Build(map, 0, 0, size, QUADTREE_NONE);
+
+	std::vector<int> leaves, stack(1, root);
+	while (stack.size() != 0)
+	{
+		int id = stack.back();
+		stack.pop_back();
+
+		if (nodes[id].children[0] == QUADTREE_NONE)
+		{
+			Fill(id);
+			leaves.push_back(id);
+		}
+		else
+		{
+			stack.insert(stack.end(), nodes[id].children, nodes[id].children + 4);
+		}
+	}
+	for (std::vector<int>::const_iterator item = leaves.begin(); item != leaves.end(); ++item)
+		Relink(*item);
+
+	LOG("Quadtree: %u leaves over %u tiles", leaf_count, width*height);
+}
+
+void QuadTree::Fill(int id)
+{
+	const Node& node = nodes[id];
+
+	for (int y = node.y; y < MIN(node.y + node.size, (int)height); ++y)
+		for (int x = node.x; x < MIN(node.x + node.size, (int)width); ++x)
+			leaf_of[(y * width) + x] = id;
+}
+
+// Walkable leaves on the other side of each edge, corner contacts are left out
+void QuadTree::Relink(int id)
+{
+	std::vector<int>& leaf_links = links[id];
+	leaf_links.clear();
+
+	const Node& node = nodes[id];
+	if (node.children[0] != QUADTREE_NONE || node.walkable == false || node.x >= (int)width || node.y >= (int)height)
+		return;
+
+	auto visit = [&](int x, int y)
+	{
+		if (x < 0 || y < 0 || x >= (int)width || y >= (int)height)
+			return;
+
+		int leaf = leaf_of[(y * width) + x];
+		if (nodes[leaf].walkable == true && (leaf_links.size() == 0 || leaf_links.back() != leaf))
+			leaf_links.push_back(leaf);
+	};
+
+	for (int i = 0; i < node.size; ++i)
+	{
+		visit(node.x + i, node.y - 1);
+		visit(node.x + i, node.y + node.size);
+		visit(node.x - 1, node.y + i);
+		visit(node.x + node.size, node.y + i);
+	}
+
+	std::sort(leaf_links.begin(), leaf_links.end());
+	leaf_links.erase(std::unique(leaf_links.begin(), leaf_links.end()), leaf_links.end());
+}
+
+// ----------------------------------------------------------------------------------
+// The leaf is split into quadrants down to the tile, then parents whose four
+// children are leaves of the same kind collapse again. Only the leaves of the old
+// square and the ring around it can have new links
+// ----------------------------------------------------------------------------------
+void QuadTree::SetTile(const iPoint& pos, const uchar* map)
+{
+	if (root == QUADTREE_NONE)
+		return;
+
+	int id = leaf_of[(pos.y * width) + pos.x];
+	bool walkable = TileWalkable(map, pos.x, pos.y);
+	if (nodes[id].walkable == walkable)
+		return;
+
+	int area_x = nodes[id].x, area_y = nodes[id].y, area_size = nodes[id].size;
+
+	while (nodes[id].size > 1)
+	{
+		int x = nodes[id].x, y = nodes[id].y, half = nodes[id].size / 2;
+		links[id].clear();
+
+		for (uint i = 0; i < 4; ++i)
+		{
+			int child = NewNode(x + (i & 1) * half, y + (i >> 1) * half, half, id);
+			nodes[child].walkable = nodes[id].walkable;
+			nodes[id].children[i] = child;
+			Fill(child);
+		}
+		leaf_count += 3;
+
+		id = nodes[id].children[((pos.y >= y + half) ? 2 : 0) + ((pos.x >= x + half) ? 1 : 0)];
+	}
+	nodes[id].walkable = walkable;
+
+	for (int parent = nodes[id].parent; parent != QUADTREE_NONE; parent = nodes[parent].parent)
+	{
+		const int* children = nodes[parent].children;
+		bool uniform = true;
+		for (uint i = 0; i < 4 && uniform == true; ++i)
+			uniform = nodes[children[i]].children[0] == QUADTREE_NONE && nodes[children[i]].walkable == nodes[children[0]].walkable;
+
+		if (uniform == false)
+			break;
+
+		nodes[parent].walkable = nodes[children[0]].walkable;
+		for (uint i = 0; i < 4; ++i)
+			FreeNode(children[i]);
+		for (uint i = 0; i < 4; ++i)
+			nodes[parent].children[i] = QUADTREE_NONE;
+		leaf_count -= 3;
+		Fill(parent);
+
+		if (nodes[parent].size > area_size)
+		{
+			area_x = nodes[parent].x;
+			area_y = nodes[parent].y;
+			area_size = nodes[parent].size;
+		}
+	}
+
+	std::vector<int> touched;
+	for (int y = MAX(area_y - 1, 0); y < MIN(area_y + area_size + 1, (int)height); ++y)
+		for (int x = MAX(area_x - 1, 0); x < MIN(area_x + area_size + 1, (int)width); ++x)
+			touched.push_back(leaf_of[(y * width) + x]);
+
+	std::sort(touched.begin(), touched.end());
+	touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+	for (std::vector<int>::const_iterator item = touched.begin(); item != touched.end(); ++item)
+		Relink(*item);
+}
+
+// Tiles after from up to to, diagonal steps first. Both ends are in the same walkable
+// leaf (or are neighbours across an edge) so every tile in between is free
+void QuadTree::AppendSteps(const iPoint& from, const iPoint& to, std::vector<iPoint>& path_to_fill) const
+{
+	iPoint pos = from;
+
+	while (pos != to)
+	{
+		pos.x += (to.x > pos.x) ? 1 : ((to.x < pos.x) ? -1 : 0);
+		pos.y += (to.y > pos.y) ? 1 : ((to.y < pos.y) ? -1 : 0);
+		path_to_fill.push_back(pos);
+	}
+}
+
+// ----------------------------------------------------------------------------------
+// A* over walkable leaves. A leaf is entered on the tile next to the one the path
+// left the previous leaf from, chosen on the shared edge as close as it gets to
+// where the previous leaf was entered
+// ----------------------------------------------------------------------------------
+bool QuadTree::FindPath(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const
+{
+	typedef std::pair<int, int> Entry;
+
+	if (root == QUADTREE_NONE ||
+		origin.x < 0 || origin.y < 0 || origin.x >= (int)width || origin.y >= (int)height ||
+		destination.x < 0 || destination.y < 0 || destination.x >= (int)width || destination.y >= (int)height)
+		return false;
+
+	int first = leaf_of[(origin.y * width) + origin.x];
+	int goal = leaf_of[(destination.y * width) + destination.x];
+	if (nodes[first].walkable == false || nodes[goal].walkable == false)
+		return false;
+
+	uint count = nodes.size();
+	std::vector<int> g(count, -1);
+	std::vector<int> came_from(count, QUADTREE_NONE);
+	std::vector<iPoint> entry(count);
+	std::vector<iPoint> left_from(count);
+	std::vector<bool> closed(count, false);
+	std::vector<Entry> open;
+
+	g[first] = 0;
+	entry[first] = origin;
+	open.push_back(Entry(DefaultSearchPolicy::H(origin, destination), first));
+
+	while (open.size() != 0)
+	{
+		std::pop_heap(open.begin(), open.end(), std::greater<Entry>());
+		int current = open.back().second;
+		open.pop_back();
+
+		if (closed[current] == true)
+			continue;
+		closed[current] = true;
+
+		if (current == goal)
+			break;
+
+		const Node& a = nodes[current];
+		const iPoint& from = entry[current];
+		for (std::vector<int>::const_iterator item = links[current].begin(); item != links[current].end(); ++item)
+		{
+			int next = *item;
+			if (closed[next] == true)
+				continue;
+
+			const Node& b = nodes[next];
+			iPoint exit, enter;
+			if (b.x >= a.x + a.size || b.x + b.size <= a.x)
+			{
+				int y = MIN(MAX(from.y, MAX(a.y, b.y)), MIN(a.y + a.size, b.y + b.size) - 1);
+				bool right = (b.x >= a.x + a.size);
+				exit.create(right ? a.x + a.size - 1 : a.x, y);
+				enter.create(right ? b.x : b.x + b.size - 1, y);
+			}
+			else
+			{
+				int x = MIN(MAX(from.x, MAX(a.x, b.x)), MIN(a.x + a.size, b.x + b.size) - 1);
+				bool below = (b.y >= a.y + a.size);
+				exit.create(x, below ? a.y + a.size - 1 : a.y);
+				enter.create(x, below ? b.y : b.y + b.size - 1);
+			}
+
+			int new_g = g[current] + DefaultSearchPolicy::H(from, exit) + DefaultSearchPolicy::Cost::STRAIGHT;
+			if (g[next] >= 0 && new_g >= g[next])
+				continue;
+
+			g[next] = new_g;
+			came_from[next] = current;
+			entry[next] = enter;
+			left_from[next] = exit;
+			open.push_back(Entry(new_g + DefaultSearchPolicy::H(enter, destination), next));
+			std::push_heap(open.begin(), open.end(), std::greater<Entry>());
+		}
+	}
+
+	if (closed[goal] == false)
+		return false;
+
+	std::vector<int> leaves;
+	for (int leaf = goal; leaf != QUADTREE_NONE; leaf = came_from[leaf])
+		leaves.push_back(leaf);
+	std::reverse(leaves.begin(), leaves.end());
+
+	path_to_fill.clear();
+	path_to_fill.push_back(origin);
+	for (uint i = 1; i < leaves.size(); ++i)
+	{
+		iPoint pos = path_to_fill.back();
+		AppendSteps(pos, left_from[leaves[i]], path_to_fill);
+		path_to_fill.push_back(entry[leaves[i]]);
+	}
+	iPoint pos = path_to_fill.back();
+	AppendSteps(pos, destination, path_to_fill);
+
+	return true;
+}
@@ -0,0 +1,77 @@
+#ifndef __PATHQUADTREE_H__
+#define __PATHQUADTREE_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+
+#define QUADTREE_NONE -1
+
+// --------------------------------------------------
+// Region quadtree over the walkability map
+// Samet: "The Quadtree and Related Hierarchical Data Structures"
+// The map is padded to a power of two square, tiles outside it are blocked.
+// Squares that are all walkable or all blocked are single leaves, walkable
+// leaves sharing an edge are linked and searched instead of their tiles. Inside
+// a walkable leaf every tile is free, so the path between the points where it
+// enters and leaves a leaf is filled in with straight and diagonal steps.
+// --------------------------------------------------
+
+// ---------------------------------------------------------------------
+// QuadTree: the nodes, the leaf of every tile and the leaf links
+// ---------------------------------------------------------------------
+class QuadTree
+{
+public:
+
+	QuadTree();
+
+	// Builds the tree of a walkability map
+	void SetMap(uint width, uint height, const uchar* map);
+
+	// Releases the tree
+	void CleanUp();
+
+	// A tile changed: its leaf is split down to the tile and merged back up as far as it goes
+	void SetTile(const iPoint& pos, const uchar* map);
+
+	// A* over walkable leaves, the path is filled tile by tile
+	bool FindPath(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const;
+
+	// Number of leaves in use, walkable or not
+	uint GetLeafCount() const;
+
+private:
+
+	struct Node
+	{
+		int x, y, size;
+		int parent;
+		// QUADTREE_NONE for leaves
+		int children[4];
+		bool walkable;
+	};
+
+	int NewNode(int x, int y, int size, int parent);
+	void FreeNode(int id);
+	int Build(const uchar* map, int x, int y, int size, int parent);
+	bool TileWalkable(const uchar* map, int x, int y) const;
+	void Fill(int id);
+	void Relink(int id);
+	void AppendSteps(const iPoint& from, const iPoint& to, std::vector<iPoint>& path_to_fill) const;
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	int root = QUADTREE_NONE;
+	uint leaf_count = 0;
+	std::vector<Node> nodes;
+	std::vector<int> free_nodes;
+	// leaf of every map tile
+	std::vector<int> leaf_of;
+	// walkable leaves sharing an edge, empty for the rest
+	std::vector<std::vector<int>> links;
+};
+
+#endif // __PATHQUADTREE_H__
@@ -0,0 +1,194 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "j1App.h"
+#include "j1PathFinding.h"
+#include "PathRooms.h"
+#include <functional>
+
+RoomGraph::RoomGraph()
+{}
+
+void RoomGraph::CleanUp()
+{
+	room_of.clear();
+	portal_of.clear();
+	room_centres.clear();
+	links.clear();
+	width = height = portal_count = 0;
+}
+
+uint RoomGraph::GetRoomCount() const
+{
+	return room_centres.size();
+}
+
+int RoomGraph::GetRoom(const iPoint& pos) const
+{
+	if (room_of.size() == 0 || pos.x < 0 || pos.y < 0 || pos.x >= (int)width || pos.y >= (int)height)
+		return ROOM_NONE;
+
+	return room_of[(pos.y * width) + pos.x];
+}
+
+void RoomGraph::SetRooms(uint width, uint height, const std::vector<SDL_Rect>& rooms, const std::vector<SDL_Rect>& portals)
+{
+	CleanUp();
+
+	this->width = width;
+	this->height = height;
+	portal_count = portals.size();
+	room_of.assign(width*height, ROOM_NONE);
+	portal_of.assign(width*height, ROOM_NONE);
+
+	// rectangles are clipped to the map, earlier ones keep the tiles they share
+	auto fill = [&](std::vector<int>& owner, const SDL_Rect& rect, int id)
+	{
+		for (int y = MAX(rect.y, 0); y < MIN(rect.y + rect.h, (int)height); ++y)
+			for (int x = MAX(rect.x, 0); x < MIN(rect.x + rect.w, (int)width); ++x)
+				if (owner[(y * width) + x] == ROOM_NONE)
+					owner[(y * width) + x] = id;
+	};
+
+	for (uint i = 0; i < rooms.size(); ++i)
+	{
+		fill(room_of, rooms[i], i);
+		room_centres.push_back(iPoint(rooms[i].x + rooms[i].w / 2, rooms[i].y + rooms[i].h / 2));
+	}
+
+	for (uint i = 0; i < portals.size(); ++i)
+		fill(portal_of, portals[i], i);
+
+	// a portal links every room it overlaps or borders, through its centre
+	links.resize(rooms.size());
+	uint link_count = 0;
+	for (uint i = 0; i < portals.size(); ++i)
+	{
+		const SDL_Rect& rect = portals[i];
+		iPoint centre(rect.x + rect.w / 2, rect.y + rect.h / 2);
+		std::vector<int> touched;
+
+		for (int y = MAX(rect.y - 1, 0); y < MIN(rect.y + rect.h + 1, (int)height); ++y)
+		{
+			for (int x = MAX(rect.x - 1, 0); x < MIN(rect.x + rect.w + 1, (int)width); ++x)
+			{
+				int room = room_of[(y * width) + x];
+				if (room != ROOM_NONE && std::find(touched.begin(), touched.end(), room) == touched.end())
+					touched.push_back(room);
+			}
+		}
+
+		for (uint a = 0; a < touched.size(); ++a)
+		{
+			for (uint b = a + 1; b < touched.size(); ++b)
+			{
+				int cost = DefaultSearchPolicy::H(room_centres[touched[a]], centre) + DefaultSearchPolicy::H(centre, room_centres[touched[b]]);
+				Link forward = { touched[b], (int)i, cost };
+				Link backward = { touched[a], (int)i, cost };
+				links[touched[a]].push_back(forward);
+				links[touched[b]].push_back(backward);
+				link_count++;
+			}
+		}
+	}
+
+	LOG("Room graph: %u rooms, %u portals, %u links", rooms.size(), portals.size(), link_count);
+}
+
+// Dijkstra over the rooms, the graph is tiny next to the tile grid
+bool RoomGraph::FindRoute(int origin_room, int destination_room, std::vector<bool>& route_rooms, std::vector<bool>& route_portals) const
+{
+	typedef std::pair<int, int> Entry;
+
+	uint room_count = room_centres.size();
+	std::vector<int> cost(room_count, -1);
+	std::vector<int> came_from(room_count, ROOM_NONE);
+	std::vector<int> through(room_count, ROOM_NONE);
+	std::vector<Entry> open;
+
+	cost[origin_room] = 0;
+	open.push_back(Entry(0, origin_room));
+
+	while (open.size() != 0)
+	{
+		std::pop_heap(open.begin(), open.end(), std::greater<Entry>());
+		Entry current = open.back();
+		open.pop_back();
+
+		if (current.first > cost[current.second])
+			continue;
+		if (current.second == destination_room)
+			break;
+
+		const std::vector<Link>& room_links = links[current.second];
+		for (std::vector<Link>::const_iterator item = room_links.begin(); item != room_links.end(); ++item)
+		{
+			int g = current.first + item->cost;
+			if (cost[item->room] >= 0 && g >= cost[item->room])
+				continue;
+
+			cost[item->room] = g;
+			came_from[item->room] = current.second;
+			through[item->room] = item->portal;
+			open.push_back(Entry(g, item->room));
+			std::push_heap(open.begin(), open.end(), std::greater<Entry>());
+		}
+	}
+
+	if (cost[destination_room] < 0)
+		return false;
+
+	route_rooms.assign(room_count, false);
+	route_portals.assign(portal_count, false);
+	for (int room = destination_room; room != ROOM_NONE; room = came_from[room])
+	{
+		route_rooms[room] = true;
+		if (through[room] != ROOM_NONE)
+			route_portals[through[room]] = true;
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------
+// Hooks of the shared A*: tiles outside the rooms and portals of the route are
+// never opened
+// ----------------------------------------------------------------------------------
+struct RouteHooks : public SearchHooks<DefaultSearchPolicy>
+{
+	RouteHooks(const std::vector<int>& room_of, const std::vector<int>& portal_of, const std::vector<bool>& route_rooms,
+		const std::vector<bool>& route_portals, uint width) :
+		room_of(room_of), portal_of(portal_of), route_rooms(route_rooms), route_portals(route_portals), width(width)
+	{}
+
+	inline int H(const iPoint& pos, const iPoint& destination)
+	{
+		int tile = (pos.y * width) + pos.x;
+		int room = room_of[tile], portal = portal_of[tile];
+		if ((room == ROOM_NONE || route_rooms[room] == false) && (portal == ROOM_NONE || route_portals[portal] == false))
+			return -1;
+
+		return DefaultSearchPolicy::H(pos, destination);
+	}
+
+	const std::vector<int>& room_of;
+	const std::vector<int>& portal_of;
+	const std::vector<bool>& route_rooms;
+	const std::vector<bool>& route_portals;
+	uint width;
+};
+
+// The route is made per query so searches stay reentrant
+bool RoomGraph::FindPath(SearchContext& context, const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const
+{
+	int origin_room = GetRoom(origin), destination_room = GetRoom(destination);
+	if (origin_room == ROOM_NONE || destination_room == ROOM_NONE ||
+		App->pathfinding->IsWalkable(origin) == false || App->pathfinding->IsWalkable(destination) == false)
+		return false;
+
+	std::vector<bool> route_rooms, route_portals;
+	if (FindRoute(origin_room, destination_room, route_rooms, route_portals) == false)
+		return false;
+
+	RouteHooks hooks(room_of, portal_of, route_rooms, route_portals, width);
+	return App->pathfinding->FindPath<DefaultSearchPolicy>(context, origin, destination, path_to_fill, hooks);
+}
@@ -0,0 +1,65 @@
+#ifndef __PATHROOMS_H__
+#define __PATHROOMS_H__
+
+#include "p2Point.h"
+#include "SDL\include\SDL_rect.h"
+#include <vector>
+
+#define ROOM_NONE -1
+
+// --------------------------------------------------
+// Room graph
+// Level designers mark rooms and the portals between them in a TMX object group
+// (see j1Map::CreateRoomMap). A portal joins every room its rectangle touches.
+// A query first finds the cheapest chain of rooms between the room centres, then
+// the tile search only opens tiles of the rooms and portals on that chain.
+// --------------------------------------------------
+class SearchContext;
+
+// ---------------------------------------------------------------------
+// RoomGraph: room and portal of every tile and the links between rooms
+// ---------------------------------------------------------------------
+class RoomGraph
+{
+public:
+
+	RoomGraph();
+
+	// Rooms and portals in tiles, a tile inside two rooms belongs to the first
+	void SetRooms(uint width, uint height, const std::vector<SDL_Rect>& rooms, const std::vector<SDL_Rect>& portals);
+
+	// Releases the graph
+	void CleanUp();
+
+	// Room of a tile, ROOM_NONE if there is none
+	int GetRoom(const iPoint& pos) const;
+
+	uint GetRoomCount() const;
+
+	// Rooms and portals on the cheapest room chain, false if the rooms are not linked
+	bool FindRoute(int origin_room, int destination_room, std::vector<bool>& route_rooms, std::vector<bool>& route_portals) const;
+
+	// A* restricted to the route between the rooms of origin and destination
+	bool FindPath(SearchContext& context, const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const;
+
+private:
+
+	struct Link
+	{
+		int room;
+		int portal;
+		int cost;
+	};
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	uint portal_count = 0;
+	std::vector<int> room_of;
+	std::vector<int> portal_of;
+	std::vector<iPoint> room_centres;
+	std::vector<std::vector<Link>> links;
+};
+
+#endif // __PATHROOMS_H__
@@ -0,0 +1,255 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "PathPolicies.h"
+#include "PathSelector.h"
+
+typedef GridNeighbours<DefaultSearchPolicy> Neighbours;
+
+PathSelector::PathSelector()
+{}
+
+void PathSelector::CleanUp()
+{
+	labels.clear();
+	labels.shrink_to_fit();
+	parents.clear();
+	blocked.clear();
+	stale = false;
+	width = height = blocks_width = blocks_height = 0;
+}
+
+void PathSelector::SetExploreEvery(uint queries)
+{
+	explore_every = queries;
+}
+
+const EngineStats& PathSelector::GetStats(PathEngine engine) const
+{
+	return stats[engine];
+}
+
+const char* PathSelector::GetEngineName(PathEngine engine)
+{
+	switch (engine)
+	{
+	case PATH_ENGINE_DATABASE: return "database";
+	case PATH_ENGINE_LANES: return "lanes";
+	case PATH_ENGINE_RSR: return "rsr";
+	default: return "unknown";
+	}
+}
+
+void PathSelector::SetMap(uint width, uint height, const uchar* map)
+{
+	CleanUp();
+
+	this->width = width;
+	this->height = height;
+
+	blocks_width = (width + SELECTOR_BLOCK - 1) / SELECTOR_BLOCK;
+	blocks_height = (height + SELECTOR_BLOCK - 1) / SELECTOR_BLOCK;
+	blocked.assign(blocks_width * blocks_height, 0);
+	for (uint y = 0; y < height; ++y)
+		for (uint x = 0; x < width; ++x)
+			if (Neighbours::Walkable(map, width, height, x, y) == false)
+				blocked[((y / SELECTOR_BLOCK) * blocks_width) + (x / SELECTOR_BLOCK)]++;
+
+	Label(map);
+
+	for (uint i = 0; i < SELECTOR_DISTANCE_BUCKETS * SELECTOR_DENSITY_BUCKETS; ++i)
+		buckets[i] = BucketStats();
+	for (uint i = 0; i < PATH_ENGINE_COUNT; ++i)
+		stats[i] = EngineStats();
+}
+
+// Diagonal steps need both side tiles free, so 4-connected components are the 8-connected ones
+void PathSelector::Label(const uchar* map)
+{
+	labels.assign(width*height, 0);
+	parents.assign(1, 0);
+	stale = false;
+
+	std::vector<uint> stack;
+	for (uint i = 0; i < width*height; ++i)
+	{
+		if (labels[i] != 0 || Neighbours::Walkable(map, width, height, i % width, i / width) == false)
+			continue;
+
+		uint label = parents.size();
+		parents.push_back(label);
+		labels[i] = label;
+		stack.push_back(i);
+
+		while (stack.size() != 0)
+		{
+			uint tile = stack.back();
+			stack.pop_back();
+			int x = tile % width, y = tile / width;
+
+			for (uint dir = 0; dir < 4; ++dir)
+			{
+				int nx = x + grid_dirs[dir][0], ny = y + grid_dirs[dir][1];
+				if (Neighbours::Walkable(map, width, height, nx, ny) == false)
+					continue;
+
+				uint next = (ny * width) + nx;
+				if (labels[next] == 0)
+				{
+					labels[next] = label;
+					stack.push_back(next);
+				}
+			}
+		}
+	}
+}
+
+uint PathSelector::Find(uint label)
+{
+	while (parents[label] != label)
+	{
+		parents[label] = parents[parents[label]];
+		label = parents[label];
+	}
+
+	return label;
+}
+
+void PathSelector::SetTile(const iPoint& pos, const uchar* map)
+{
+	if (labels.size() == 0)
+		return;
+
+	uint index = (pos.y * width) + pos.x;
+	bool walkable = Neighbours::Walkable(map, width, height, pos.x, pos.y);
+	if (walkable == (labels[index] != 0))
+		return;
+
+	uint& count = blocked[((pos.y / SELECTOR_BLOCK) * blocks_width) + (pos.x / SELECTOR_BLOCK)];
+	if (walkable == false)
+	{
+		// the component may be split now, Connected stays true until a search says otherwise
+		labels[index] = 0;
+		count++;
+		return;
+	}
+
+	count--;
+
+	uint label = 0;
+	for (uint dir = 0; dir < 4; ++dir)
+	{
+		int nx = pos.x + grid_dirs[dir][0], ny = pos.y + grid_dirs[dir][1];
+		if (nx < 0 || ny < 0 || nx >= (int)width || ny >= (int)height || labels[(ny * width) + nx] == 0)
+			continue;
+
+		uint root = Find(labels[(ny * width) + nx]);
+		if (label == 0)
+			label = root;
+		else if (root != label)
+			parents[root] = label;
+	}
+
+	if (label == 0)
+	{
+		label = parents.size();
+		parents.push_back(label);
+	}
+
+	labels[index] = label;
+}
+
+bool PathSelector::Connected(const iPoint& origin, const iPoint& destination, const uchar* map)
+{
+	if (labels.size() == 0)
+		return true;
+
+	if (stale == true)
+	{
+		LOG("Path selector: relabelling components after a failed search");
+		Label(map);
+	}
+
+	uint a = labels[(origin.y * width) + origin.x];
+	uint b = labels[(destination.y * width) + destination.x];
+	return a != 0 && b != 0 && Find(a) == Find(b);
+}
+
+void PathSelector::Disconnected()
+{
+	stale = true;
+}
+
+// ----------------------------------------------------------------------------------
+// Distance buckets grow by four times: under 16 tiles, 64, 256 and the rest. The
+// density is counted over the whole squares the endpoint box touches
+// ----------------------------------------------------------------------------------
+uint PathSelector::Bucket(const iPoint& origin, const iPoint& destination) const
+{
+	int tiles = DefaultSearchPolicy::H(origin, destination) / DefaultSearchPolicy::Cost::STRAIGHT;
+	uint distance = 0;
+	for (int limit = 16; distance < SELECTOR_DISTANCE_BUCKETS - 1 && tiles >= limit; limit *= 4)
+		distance++;
+
+	uint density = 0;
+	if (blocked.size() != 0)
+	{
+		uint min_x = MIN(origin.x, destination.x) / SELECTOR_BLOCK, max_x = MAX(origin.x, destination.x) / SELECTOR_BLOCK;
+		uint min_y = MIN(origin.y, destination.y) / SELECTOR_BLOCK, max_y = MAX(origin.y, destination.y) / SELECTOR_BLOCK;
+
+		uint count = 0;
+		for (uint y = min_y; y <= max_y; ++y)
+			for (uint x = min_x; x <= max_x; ++x)
+				count += blocked[(y * blocks_width) + x];
+
+		uint area = (MIN((max_x + 1) * SELECTOR_BLOCK, width) - (min_x * SELECTOR_BLOCK)) *
+			(MIN((max_y + 1) * SELECTOR_BLOCK, height) - (min_y * SELECTOR_BLOCK));
+
+		// under 10%, under 30% and the rest
+		if (count * 10 >= area)
+			density++;
+		if (count * 10 >= area * 3)
+			density++;
+	}
+
+	return (distance * SELECTOR_DENSITY_BUCKETS) + density;
+}
+
+PathEngine PathSelector::Choose(uint bucket, const bool* available)
+{
+	BucketStats& item = buckets[bucket];
+	item.queries++;
+
+	int least_tried = -1, fastest = -1;
+	for (int engine = 0; engine < PATH_ENGINE_COUNT; ++engine)
+	{
+		if (available[engine] == false)
+			continue;
+
+		if (least_tried == -1 || item.samples[engine] < item.samples[least_tried])
+			least_tried = engine;
+		if (fastest == -1 || item.mean_ms[engine] < item.mean_ms[fastest])
+			fastest = engine;
+	}
+
+	if (least_tried == -1)
+		return PATH_ENGINE_LANES;
+
+	if (item.samples[least_tried] < SELECTOR_WARMUP || (explore_every != 0 && item.queries % explore_every == 0))
+		return (PathEngine)least_tried;
+
+	return (PathEngine)fastest;
+}
+
+// Plain mean over the warmup, then an exponential one so old samples fade out
+void PathSelector::Record(uint bucket, PathEngine engine, float ms)
+{
+	BucketStats& item = buckets[bucket];
+	uint samples = ++item.samples[engine];
+	float rate = (samples <= SELECTOR_WARMUP) ? (1.0f / samples) : SELECTOR_LEARNING_RATE;
+	item.mean_ms[engine] += (ms - item.mean_ms[engine]) * rate;
+
+	EngineStats& total = stats[engine];
+	total.queries++;
+	total.total_ms += ms;
+	total.worst_ms = MAX(total.worst_ms, ms);
+}
@@ -0,0 +1,122 @@
+#ifndef __PATHSELECTOR_H__
+#define __PATHSELECTOR_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+
+// one query in this many per bucket goes to the engine tried least, 0 never explores
+#define DEFAULT_SELECTOR_EXPLORE_EVERY 32
+// first queries of a bucket every engine gets before the means are trusted
+#define SELECTOR_WARMUP 4
+// weight of a new sample once the warmup is over
+#define SELECTOR_LEARNING_RATE 0.1f
+// side of the squares blocked tiles are counted in
+#define SELECTOR_BLOCK 8
+#define SELECTOR_DISTANCE_BUCKETS 4
+#define SELECTOR_DENSITY_BUCKETS 3
+
+// --------------------------------------------------
+// Per query engine selection
+// Every engine here returns the same optimal tile path, they only differ in how
+// long they take, which depends on the query. Queries are put in a bucket by
+// their octile distance and the share of blocked tiles in the box between the
+// endpoints, and each bucket keeps a running mean of the ms every engine took
+// on it. The engine with the lowest mean is used, with some warmup and regular
+// exploration so the means follow the map as it changes.
+// Endpoints in different components are answered without searching: tiles keep
+// a component label joined with union-find when a tile opens. A closing tile
+// can split a component, labels are only redone when a search finds no path
+// between two tiles they said were connected.
+// --------------------------------------------------
+enum PathEngine
+{
+	PATH_ENGINE_DATABASE = 0,
+	PATH_ENGINE_LANES,
+	PATH_ENGINE_RSR,
+	PATH_ENGINE_COUNT
+};
+
+// ---------------------------------------------------------------------
+// EngineStats: what an engine did since the map was set
+// ---------------------------------------------------------------------
+struct EngineStats
+{
+	uint queries = 0;
+	double total_ms = 0.0;
+	float worst_ms = 0.0f;
+};
+
+// ---------------------------------------------------------------------
+// PathSelector: component labels, blocked tile counts and engine means
+// ---------------------------------------------------------------------
+class PathSelector
+{
+public:
+
+	PathSelector();
+
+	// Labels the components and counts blocked tiles, statistics start over
+	void SetMap(uint width, uint height, const uchar* map);
+
+	// Frees the labels and counts
+	void CleanUp();
+
+	void SetExploreEvery(uint queries);
+
+	// A tile changed: an opening tile joins the components around it
+	void SetTile(const iPoint& pos, const uchar* map);
+
+	// False when the endpoints can't reach each other, labels are redone first
+	// if a search proved them stale
+	bool Connected(const iPoint& origin, const iPoint& destination, const uchar* map);
+
+	// A search failed between two tiles Connected accepted
+	void Disconnected();
+
+	// Bucket of a query by its distance and obstacle density
+	uint Bucket(const iPoint& origin, const iPoint& destination) const;
+
+	// Engine to use for a query of this bucket among the available ones
+	PathEngine Choose(uint bucket, const bool* available);
+
+	// Time an engine took on a query of this bucket
+	void Record(uint bucket, PathEngine engine, float ms);
+
+	const EngineStats& GetStats(PathEngine engine) const;
+
+	static const char* GetEngineName(PathEngine engine);
+
+private:
+
+	void Label(const uchar* map);
+	uint Find(uint label);
+
+	struct BucketStats
+	{
+		uint queries = 0;
+		uint samples[PATH_ENGINE_COUNT] = {};
+		float mean_ms[PATH_ENGINE_COUNT] = {};
+	};
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	uint explore_every = DEFAULT_SELECTOR_EXPLORE_EVERY;
+
+	// component label of every tile, 0 for blocked ones, and the union-find parents
+	std::vector<uint> labels;
+	std::vector<uint> parents;
+	bool stale = false;
+
+	// blocked tiles in every SELECTOR_BLOCK square
+	uint blocks_width = 0;
+	uint blocks_height = 0;
+	std::vector<uint> blocked;
+
+	BucketStats buckets[SELECTOR_DISTANCE_BUCKETS * SELECTOR_DENSITY_BUCKETS];
+	EngineStats stats[PATH_ENGINE_COUNT];
+};
+
+#endif // __PATHSELECTOR_H__
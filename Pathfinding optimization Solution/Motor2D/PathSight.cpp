@@ -0,0 +1,203 @@
+#include "p2Defs.h"
+#include "j1PathFinding.h"
+#include "PathSight.h"
+
+SightMap::SightMap()
+{}
+
+void SightMap::SetMap(uint width, uint height, const uchar* data)
+{
+	this->width = width;
+	this->height = height;
+	row_words = (width + 63) >> 6;
+
+	bits.assign(row_words * height, 0);
+	for (uint y = 0; y < height; ++y)
+	{
+		for (uint x = 0; x < width; ++x)
+		{
+			uchar t = data[(y*width) + x];
+			if (t != INVALID_WALK_CODE && t > 0)
+				bits[y * row_words + (x >> 6)] |= (uint64)1 << (x & 63);
+		}
+	}
+	bits.shrink_to_fit();
+}
+
+void SightMap::CleanUp()
+{
+	bits.clear();
+	bits.shrink_to_fit();
+	width = height = row_words = 0;
+}
+
+void SightMap::SetTile(const iPoint& pos, bool walkable)
+{
+	uint64& word = bits[pos.y * row_words + (pos.x >> 6)];
+	uint64 bit = (uint64)1 << (pos.x & 63);
+
+	word = walkable ? (word | bit) : (word & ~bit);
+}
+
+uint SightMap::GetMemoryUsage() const
+{
+	return bits.capacity() * sizeof(uint64);
+}
+
+// ----------------------------------------------------------------------------------
+// Walks every tile the segment crosses with integer error terms only. The tiles
+// stay inside the bounding box of both ends, so only the ends are bound checked
+// ----------------------------------------------------------------------------------
+bool SightMap::Clear(const iPoint& from, const iPoint& to) const
+{
+	if (from.x < 0 || from.y < 0 || from.x >= (int)width || from.y >= (int)height ||
+		to.x < 0 || to.y < 0 || to.x >= (int)width || to.y >= (int)height)
+		return false;
+
+	int dx = abs(to.x - from.x), dy = abs(to.y - from.y);
+	int sx = (to.x > from.x) ? 1 : -1, sy = (to.y > from.y) ? 1 : -1;
+	int x = from.x, y = from.y;
+	int error = dx - dy;
+	dx *= 2;
+	dy *= 2;
+
+	// tiles left to visit, a step through a corner skips one of them
+	int n = 1 + abs(to.x - from.x) + abs(to.y - from.y);
+
+	while (true)
+	{
+		if (Walkable(x, y) == false)
+			return false;
+
+		if (--n <= 0)
+			break;
+
+		if (error > 0)
+		{
+			x += sx;
+			error -= dy;
+		}
+		else if (error < 0)
+		{
+			y += sy;
+			error += dx;
+		}
+		else
+		{
+			// through a corner: both tiles beside it have to be walkable
+			if (Walkable(x + sx, y) == false || Walkable(x, y + sy) == false)
+				return false;
+
+			x += sx;
+			y += sy;
+			error += dx - dy;
+			--n;
+		}
+	}
+
+	return true;
+}
+
+void SightMap::ClearBatch(const SightQuery* queries, uint first, uint last, uint64* results) const
+{
+	for (uint word_start = first; word_start < last; word_start += 64)
+	{
+		uint64 word = 0;
+		uint word_end = MIN(word_start + 64, last);
+
+		for (uint i = word_start; i < word_end; ++i)
+		{
+			if (Clear(queries[i].from, queries[i].to) == true)
+				word |= (uint64)1 << (i - word_start);
+		}
+
+		results[word_start >> 6] = word;
+	}
+}
+
+SightWorkers::SightWorkers()
+{}
+
+// Destructor
+SightWorkers::~SightWorkers()
+{
+	Stop();
+}
+
+void SightWorkers::Stop()
+{
+	std::lock_guard<std::mutex> run_lock(run_mutex);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (std::vector<std::thread>::iterator item = workers.begin(); item != workers.end(); ++item)
+		item->join();
+
+	workers.clear();
+	quit = false;
+}
+
+void SightWorkers::Run(const SightMap& sight, const SightQuery* queries, uint count, uint64* results, uint threads)
+{
+	uint per_thread = MAX((count + threads - 1) / threads, DEFAULT_SIGHT_QUERIES_PER_THREAD);
+	per_thread = (per_thread + 63) & ~63u;
+
+	uint runs = (count + per_thread - 1) / per_thread;
+	if (runs <= 1)
+	{
+		sight.ClearBatch(queries, 0, count, results);
+		return;
+	}
+
+	std::lock_guard<std::mutex> run_lock(run_mutex);
+
+	while (workers.size() < runs - 1)
+		workers.push_back(std::thread(&SightWorkers::Loop, this, workers.size(), generation));
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->sight = &sight;
+		this->queries = queries;
+		this->results = results;
+		this->count = count;
+		this->per_thread = per_thread;
+		pending = workers.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	sight.ClearBatch(queries, 0, per_thread, results);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return pending == 0; });
+}
+
+// Workers without a run in this batch only report back
+void SightWorkers::Loop(uint id, uint seen)
+{
+	while (true)
+	{
+		uint first, last;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return quit == true || generation != seen; });
+			if (quit == true)
+				return;
+
+			seen = generation;
+			first = (id + 1) * per_thread;
+			last = MIN(first + per_thread, count);
+		}
+
+		if (first < last)
+			sight->ClearBatch(queries, first, last, results);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--pending == 0)
+			done.notify_one();
+	}
+}
@@ -0,0 +1,120 @@
+#ifndef __PATHSIGHT_H__
+#define __PATHSIGHT_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// batches smaller than this per thread are not worth starting a thread for
+#define DEFAULT_SIGHT_QUERIES_PER_THREAD 2048
+
+// --------------------------------------------------
+// Line of sight over a bit-packed copy of the walkability map: a line is clear
+// when every tile its segment between tile centres crosses is walkable. Where
+// it crosses exactly through a corner both tiles of that corner must be walkable,
+// the same rule the searches use for diagonal steps.
+// --------------------------------------------------
+
+// ---------------------------------------------------------------------
+// SightQuery: one line to test, from and to are tile positions
+// ---------------------------------------------------------------------
+struct SightQuery
+{
+	iPoint from;
+	iPoint to;
+};
+
+// ---------------------------------------------------------------------
+// SightMap: one bit per tile, 64 tiles per word, rows start on a new word
+// ---------------------------------------------------------------------
+class SightMap
+{
+public:
+
+	SightMap();
+
+	// Packs a walkability map
+	void SetMap(uint width, uint height, const uchar* data);
+
+	// Releases the bits
+	void CleanUp();
+
+	// Updates the bit of a single tile
+	void SetTile(const iPoint& pos, bool walkable);
+
+	// Single query, false if any end is outside the map
+	bool Clear(const iPoint& from, const iPoint& to) const;
+
+	// Sets bit i of results for every clear query i in [first, last), words are
+	// written whole so first must be a multiple of 64
+	void ClearBatch(const SightQuery* queries, uint first, uint last, uint64* results) const;
+
+	uint GetMemoryUsage() const;
+
+private:
+
+	inline bool Walkable(int x, int y) const
+	{
+		return ((bits[y * row_words + (x >> 6)] >> (x & 63)) & 1) != 0;
+	}
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	uint row_words = 0;
+	std::vector<uint64> bits;
+};
+
+// ---------------------------------------------------------------------
+// SightWorkers: threads kept for batches too big for one thread. They
+// are started by the first batch that needs them and sleep in between,
+// so a batch only pays for waking them up
+// ---------------------------------------------------------------------
+class SightWorkers
+{
+public:
+
+	SightWorkers();
+
+	// Destructor
+	~SightWorkers();
+
+	// SightMap::ClearBatch over every query, split in runs of whole words between the
+	// calling thread and up to threads - 1 workers. Runs inline below
+	// DEFAULT_SIGHT_QUERIES_PER_THREAD queries a thread
+	void Run(const SightMap& sight, const SightQuery* queries, uint count, uint64* results, uint threads);
+
+	// Joins the workers, the next batch that needs them starts them again
+	void Stop();
+
+private:
+
+	// seen is the last batch before the worker started
+	void Loop(uint id, uint seen);
+
+private:
+
+	// one batch at a time
+	std::mutex run_mutex;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::vector<std::thread> workers;
+
+	// batch the workers are woken up for, worker i takes run i + 1
+	const SightMap* sight = nullptr;
+	const SightQuery* queries = nullptr;
+	uint64* results = nullptr;
+	uint count = 0;
+	uint per_thread = 0;
+	uint generation = 0;
+	uint pending = 0;
+	bool quit = false;
+};
+
+#endif // __PATHSIGHT_H__
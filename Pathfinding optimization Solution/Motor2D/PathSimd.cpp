@@ -0,0 +1,223 @@
+#include "p2Defs.h"
+#include "j1PathFinding.h"
+#include "PathSimd.h"
+#include "SDL\include\SDL_cpuinfo.h"
+#include <immintrin.h>
+
+#define LANE_STRAIGHT DefaultSearchPolicy::Cost::STRAIGHT
+#define LANE_DIAGONAL DefaultSearchPolicy::Cost::DIAGONAL
+
+// orthogonal tiles a diagonal needs with no corner cutting, cardinals point to themselves
+static const int lane_side_a[LANE_NEIGHBOURS] = { 0, 1, 2, 3, 0, 0, 1, 1 };
+static const int lane_side_b[LANE_NEIGHBOURS] = { 0, 1, 2, 3, 2, 3, 2, 3 };
+static const int lane_dx[LANE_NEIGHBOURS] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+static const int lane_dy[LANE_NEIGHBOURS] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+
+// LaneNodes ----------------------------------------------------------------------
+// Like SearchContext, buffers only grow and two new state values per search
+// invalidate every tile of the previous ones
+// ---------------------------------------------------------------------------------
+void LaneNodes::Begin(uint padded_tiles)
+{
+	if (state.size() < padded_tiles)
+	{
+		g.resize(padded_tiles);
+		parent.resize(padded_tiles);
+		state.resize(padded_tiles, 0);
+	}
+
+	closed_state += 2;
+	if (closed_state < 2)
+	{
+		std::fill(state.begin(), state.end(), 0);
+		closed_state = 2;
+	}
+	open_state = closed_state - 1;
+	open.clear();
+}
+
+static inline bool LaneCompare(const LaneNodes::OpenEntry& l, const LaneNodes::OpenEntry& r)
+{
+	return l.score > r.score;
+}
+
+void LaneNodes::PushOpen(int index, int score)
+{
+	OpenEntry entry = { score, index };
+	open.push_back(entry);
+	std::push_heap(open.begin(), open.end(), LaneCompare);
+}
+
+int LaneNodes::PopOpen()
+{
+	if (open.size() == 0)
+		return -1;
+
+	std::pop_heap(open.begin(), open.end(), LaneCompare);
+	int ret = open.back().index;
+	open.pop_back();
+	return ret;
+}
+
+// ----------------------------------------------------------------------------------
+// Scalar kernel: same result as the vector ones, for cpus without SSE4.1
+// ----------------------------------------------------------------------------------
+uint ExpandScalar(ExpandLanes& lanes)
+{
+	const LaneNodes& nodes = *lanes.nodes;
+	bool walk[LANE_NEIGHBOURS];
+	uint mask = 0;
+
+	for (uint dir = 0; dir < LANE_NEIGHBOURS; ++dir)
+	{
+		uchar t = lanes.walk[lanes.index + lanes.offsets[dir]];
+		walk[dir] = t != INVALID_WALK_CODE && t > 0;
+	}
+
+	for (uint dir = 0; dir < LANE_NEIGHBOURS; ++dir)
+	{
+		int index = lanes.index + lanes.offsets[dir];
+
+		if (walk[dir] == false || walk[lane_side_a[dir]] == false || walk[lane_side_b[dir]] == false)
+			continue;
+
+		if (nodes.state[index] == nodes.closed_state)
+			continue;
+
+		int g = lanes.g + (dir < 4 ? LANE_STRAIGHT : LANE_DIAGONAL);
+		if (nodes.state[index] == nodes.open_state && g >= nodes.g[index])
+			continue;
+
+		lanes.new_g[dir] = g;
+		lanes.h[dir] = DefaultSearchPolicy::H(iPoint(lanes.pos.x + lane_dx[dir], lanes.pos.y + lane_dy[dir]), lanes.destination);
+		mask |= 1 << dir;
+	}
+
+	return mask;
+}
+
+// ----------------------------------------------------------------------------------
+// SSE4.1 kernel: cardinals and diagonals as two 4 lane halves
+// ----------------------------------------------------------------------------------
+static inline __m128i LaneWalkable(__m128i tile)
+{
+	__m128i blocked = _mm_or_si128(_mm_cmpeq_epi32(tile, _mm_setzero_si128()), _mm_cmpeq_epi32(tile, _mm_set1_epi32(INVALID_WALK_CODE)));
+	return _mm_xor_si128(blocked, _mm_set1_epi32(-1));
+}
+
+static inline __m128i LaneImproved(const ExpandLanes& lanes, const int* index, __m128i legal, __m128i new_g)
+{
+	const LaneNodes& nodes = *lanes.nodes;
+	const uint* state = nodes.state.data();
+	const int* g = nodes.g.data();
+
+	__m128i lane_state = _mm_setr_epi32(state[index[0]], state[index[1]], state[index[2]], state[index[3]]);
+	__m128i old_g = _mm_setr_epi32(g[index[0]], g[index[1]], g[index[2]], g[index[3]]);
+	__m128i closed = _mm_cmpeq_epi32(lane_state, _mm_set1_epi32(nodes.closed_state));
+	__m128i open = _mm_cmpeq_epi32(lane_state, _mm_set1_epi32(nodes.open_state));
+
+	// new tiles always improve, open ones only with a lower g
+	__m128i better = _mm_or_si128(_mm_xor_si128(open, _mm_set1_epi32(-1)), _mm_cmpgt_epi32(old_g, new_g));
+	return _mm_andnot_si128(closed, _mm_and_si128(legal, better));
+}
+
+static inline __m128i LaneHeuristic(const ExpandLanes& lanes, const int* dx, const int* dy)
+{
+	__m128i x = _mm_sub_epi32(_mm_set1_epi32(lanes.destination.x - lanes.pos.x), _mm_loadu_si128((const __m128i*)dx));
+	__m128i y = _mm_sub_epi32(_mm_set1_epi32(lanes.destination.y - lanes.pos.y), _mm_loadu_si128((const __m128i*)dy));
+	x = _mm_abs_epi32(x);
+	y = _mm_abs_epi32(y);
+
+	// octile: STRAIGHT * max + (DIAGONAL - STRAIGHT) * min
+	return _mm_add_epi32(_mm_mullo_epi32(_mm_max_epi32(x, y), _mm_set1_epi32(LANE_STRAIGHT)),
+		_mm_mullo_epi32(_mm_min_epi32(x, y), _mm_set1_epi32(LANE_DIAGONAL - LANE_STRAIGHT)));
+}
+
+uint ExpandSSE41(ExpandLanes& lanes)
+{
+	int index[LANE_NEIGHBOURS];
+	for (uint dir = 0; dir < LANE_NEIGHBOURS; ++dir)
+		index[dir] = lanes.index + lanes.offsets[dir];
+
+	const uchar* walk = lanes.walk;
+	__m128i walk_lo = LaneWalkable(_mm_setr_epi32(walk[index[0]], walk[index[1]], walk[index[2]], walk[index[3]]));
+	__m128i walk_hi = LaneWalkable(_mm_setr_epi32(walk[index[4]], walk[index[5]], walk[index[6]], walk[index[7]]));
+
+	// diagonals also need both orthogonal tiles, see lane_side_a and lane_side_b
+	__m128i side_a = _mm_shuffle_epi32(walk_lo, _MM_SHUFFLE(1, 1, 0, 0));
+	__m128i side_b = _mm_shuffle_epi32(walk_lo, _MM_SHUFFLE(3, 2, 3, 2));
+	walk_hi = _mm_and_si128(walk_hi, _mm_and_si128(side_a, side_b));
+
+	__m128i g_lo = _mm_set1_epi32(lanes.g + LANE_STRAIGHT);
+	__m128i g_hi = _mm_set1_epi32(lanes.g + LANE_DIAGONAL);
+	__m128i improved_lo = LaneImproved(lanes, index, walk_lo, g_lo);
+	__m128i improved_hi = LaneImproved(lanes, index + 4, walk_hi, g_hi);
+
+	_mm_storeu_si128((__m128i*)lanes.new_g, g_lo);
+	_mm_storeu_si128((__m128i*)(lanes.new_g + 4), g_hi);
+	_mm_storeu_si128((__m128i*)lanes.h, LaneHeuristic(lanes, lane_dx, lane_dy));
+	_mm_storeu_si128((__m128i*)(lanes.h + 4), LaneHeuristic(lanes, lane_dx + 4, lane_dy + 4));
+
+	return _mm_movemask_ps(_mm_castsi128_ps(improved_lo)) | (_mm_movemask_ps(_mm_castsi128_ps(improved_hi)) << 4);
+}
+
+// ----------------------------------------------------------------------------------
+// AVX2 kernel: all 8 lanes in one register, neighbour data is gathered
+// ----------------------------------------------------------------------------------
+uint ExpandAVX2(ExpandLanes& lanes)
+{
+	const LaneNodes& nodes = *lanes.nodes;
+	__m256i ones = _mm256_set1_epi32(-1);
+	__m256i index = _mm256_add_epi32(_mm256_set1_epi32(lanes.index), _mm256_loadu_si256((const __m256i*)lanes.offsets));
+
+	// one walkability byte per lane, the padded map can be read 4 bytes at a time
+	__m256i tile = _mm256_and_si256(_mm256_i32gather_epi32((const int*)lanes.walk, index, 1), _mm256_set1_epi32(0xFF));
+	__m256i blocked = _mm256_or_si256(_mm256_cmpeq_epi32(tile, _mm256_setzero_si256()), _mm256_cmpeq_epi32(tile, _mm256_set1_epi32(INVALID_WALK_CODE)));
+	__m256i walk = _mm256_xor_si256(blocked, ones);
+
+	__m256i side_a = _mm256_permutevar8x32_epi32(walk, _mm256_loadu_si256((const __m256i*)lane_side_a));
+	__m256i side_b = _mm256_permutevar8x32_epi32(walk, _mm256_loadu_si256((const __m256i*)lane_side_b));
+	__m256i legal = _mm256_and_si256(walk, _mm256_and_si256(side_a, side_b));
+
+	__m256i state = _mm256_i32gather_epi32((const int*)nodes.state.data(), index, 4);
+	__m256i old_g = _mm256_i32gather_epi32(nodes.g.data(), index, 4);
+	__m256i closed = _mm256_cmpeq_epi32(state, _mm256_set1_epi32(nodes.closed_state));
+	__m256i open = _mm256_cmpeq_epi32(state, _mm256_set1_epi32(nodes.open_state));
+
+	__m256i costs = _mm256_setr_epi32(LANE_STRAIGHT, LANE_STRAIGHT, LANE_STRAIGHT, LANE_STRAIGHT, LANE_DIAGONAL, LANE_DIAGONAL, LANE_DIAGONAL, LANE_DIAGONAL);
+	__m256i new_g = _mm256_add_epi32(_mm256_set1_epi32(lanes.g), costs);
+	__m256i better = _mm256_or_si256(_mm256_xor_si256(open, ones), _mm256_cmpgt_epi32(old_g, new_g));
+	__m256i improved = _mm256_andnot_si256(closed, _mm256_and_si256(legal, better));
+
+	__m256i x = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_set1_epi32(lanes.destination.x - lanes.pos.x), _mm256_loadu_si256((const __m256i*)lane_dx)));
+	__m256i y = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_set1_epi32(lanes.destination.y - lanes.pos.y), _mm256_loadu_si256((const __m256i*)lane_dy)));
+	__m256i h = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_max_epi32(x, y), _mm256_set1_epi32(LANE_STRAIGHT)),
+		_mm256_mullo_epi32(_mm256_min_epi32(x, y), _mm256_set1_epi32(LANE_DIAGONAL - LANE_STRAIGHT)));
+
+	_mm256_storeu_si256((__m256i*)lanes.new_g, new_g);
+	_mm256_storeu_si256((__m256i*)lanes.h, h);
+
+	return _mm256_movemask_ps(_mm256_castsi256_ps(improved));
+}
+
+ExpandKernel SelectExpandKernel(const char** name)
+{
+	ExpandKernel ret = ExpandScalar;
+	const char* ret_name = "scalar";
+
+	if (SDL_HasAVX2() == SDL_TRUE)
+	{
+		ret = ExpandAVX2;
+		ret_name = "AVX2";
+	}
+	else if (SDL_HasSSE41() == SDL_TRUE)
+	{
+		ret = ExpandSSE41;
+		ret_name = "SSE4.1";
+	}
+
+	if (name != nullptr)
+		*name = ret_name;
+
+	return ret;
+}
@@ -0,0 +1,77 @@
+#ifndef __PATHSIMD_H__
+#define __PATHSIMD_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+
+#define LANE_NEIGHBOURS 8
+
+// --------------------------------------------------
+// Vector neighbour expansion for the default rules: 8 connected, no corner
+// cutting, octile costs and heuristic. The 8 neighbours of an expanded tile are
+// lanes in grid_dirs order: walkability, corner rule, open/closed state,
+// tentative g, h and the improvement test are computed for all of them at once.
+// Maps are padded with an unwalkable border so the neighbours of any walkable
+// tile are always inside the arrays and the kernels need no bound checks.
+// --------------------------------------------------
+
+// ---------------------------------------------------------------------
+// LaneNodes: node state as struct of arrays over the padded map, so the
+// kernels can load the g and state of the 8 neighbours
+// ---------------------------------------------------------------------
+struct LaneNodes
+{
+	struct OpenEntry
+	{
+		int score;
+		int index;
+	};
+
+	// Starts a new search over a padded map of this many tiles
+	void Begin(uint padded_tiles);
+
+	void PushOpen(int index, int score);
+	int PopOpen();
+
+	std::vector<int> g;
+	std::vector<int> parent;
+	// tiles equal to open_state or closed_state belong to this search
+	std::vector<uint> state;
+	std::vector<OpenEntry> open;
+	uint open_state = 0;
+	uint closed_state = 0;
+};
+
+// ---------------------------------------------------------------------
+// ExpandLanes: input and output of one expansion
+// ---------------------------------------------------------------------
+struct ExpandLanes
+{
+	// padded walkability map, readable 4 bytes past its last tile
+	const uchar* walk;
+	const LaneNodes* nodes;
+	// padded index offset of each neighbour
+	const int* offsets;
+	// expanded tile: padded index, position and g
+	int index;
+	iPoint pos;
+	int g;
+	iPoint destination;
+
+	// only lanes set in the mask returned by the kernel are written
+	int new_g[LANE_NEIGHBOURS];
+	int h[LANE_NEIGHBOURS];
+};
+
+// Returns a bit per neighbour that is legal, not closed and improved by this expansion
+typedef uint(*ExpandKernel)(ExpandLanes& lanes);
+
+uint ExpandScalar(ExpandLanes& lanes);
+uint ExpandSSE41(ExpandLanes& lanes);
+uint ExpandAVX2(ExpandLanes& lanes);
+
+// Widest kernel this cpu can run
+ExpandKernel SelectExpandKernel(const char** name = nullptr);
+
+#endif // __PATHSIMD_H__
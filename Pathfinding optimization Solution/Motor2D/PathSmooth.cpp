@@ -0,0 +1,86 @@
+#include "p2Defs.h"
+#include "PathSight.h"
+#include "PathSmooth.h"
+
+// ----------------------------------------------------------------------------------
+// Both passes write kept waypoints over the front of the vector. The write index
+// never passes the read index, the original of the previous waypoint is kept aside
+// ----------------------------------------------------------------------------------
+void RemoveCollinear(std::vector<iPoint>& path)
+{
+	if (path.size() < 3)
+		return;
+
+	uint kept = 1;
+	iPoint previous = path[0];
+	for (uint i = 1; i + 1 < path.size(); ++i)
+	{
+		iPoint current = path[i], next = path[i + 1];
+		int ax = current.x - previous.x, ay = current.y - previous.y;
+		int bx = next.x - current.x, by = next.y - current.y;
+
+		// same line and same way on
+		if ((ax * by) - (ay * bx) != 0 || (ax * bx) + (ay * by) <= 0)
+			path[kept++] = current;
+
+		previous = current;
+	}
+
+	path[kept++] = path.back();
+	path.resize(kept);
+}
+
+void StringPull(std::vector<iPoint>& path, const SightMap& sight)
+{
+	if (path.size() < 3)
+		return;
+
+	uint kept = 1;
+	iPoint previous = path[1];
+	for (uint i = 2; i < path.size(); ++i)
+	{
+		iPoint current = path[i];
+
+		// the previous waypoint was the last one seen from the last kept one
+		if (sight.Clear(path[kept - 1], current) == false)
+			path[kept++] = previous;
+
+		previous = current;
+	}
+
+	path[kept++] = path.back();
+	path.resize(kept);
+}
+
+// Uniform Catmull-Rom, the end segments repeat their end point as the outer control point
+void CatmullRom(const std::vector<iPoint>& path, uint samples, std::vector<fPoint>& points)
+{
+	points.clear();
+
+	uint count = path.size();
+	if (count == 0)
+		return;
+
+	samples = MAX(samples, 1);
+	for (uint i = 0; i + 1 < count; ++i)
+	{
+		const iPoint& p0 = path[(i > 0) ? i - 1 : i];
+		const iPoint& p1 = path[i];
+		const iPoint& p2 = path[i + 1];
+		const iPoint& p3 = path[(i + 2 < count) ? i + 2 : i + 1];
+
+		for (uint s = 0; s < samples; ++s)
+		{
+			float t = (float)s / samples, t2 = t * t, t3 = t2 * t;
+			fPoint point;
+			point.x = 0.5f * ((2.0f * p1.x) + (p2.x - p0.x) * t + (2.0f * p0.x - 5.0f * p1.x + 4.0f * p2.x - p3.x) * t2 + (3.0f * p1.x - p0.x - 3.0f * p2.x + p3.x) * t3);
+			point.y = 0.5f * ((2.0f * p1.y) + (p2.y - p0.y) * t + (2.0f * p0.y - 5.0f * p1.y + 4.0f * p2.y - p3.y) * t2 + (3.0f * p1.y - p0.y - 3.0f * p2.y + p3.y) * t3);
+			points.push_back(point);
+		}
+	}
+
+	fPoint last;
+	last.x = (float)path.back().x;
+	last.y = (float)path.back().y;
+	points.push_back(last);
+}
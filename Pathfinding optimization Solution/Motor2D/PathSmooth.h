@@ -0,0 +1,43 @@
+#ifndef __PATHSMOOTH_H__
+#define __PATHSMOOTH_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+
+// curve points per waypoint segment
+#define DEFAULT_CURVE_SAMPLES 4
+
+// --------------------------------------------------
+// Path post-processing
+// Searches return every tile of the path. These stages cut it down to the
+// waypoints a unit actually has to turn at, working in place on the vector of
+// the path so they allocate nothing:
+// - collinear removal keeps only the tiles where the direction changes
+// - string pulling keeps a waypoint only where the straight line from the
+//   previous one is blocked (the greedy pass of Botea et al. "Near Optimal
+//   Hierarchical Path-Finding"), consecutive waypoints are then joined by
+//   walkable lines instead of tile steps
+// A Catmull-Rom spline through the waypoints gives points in tile units for
+// drawing or steering, it can cut a little inside tight corners.
+// --------------------------------------------------
+class SightMap;
+
+enum PathPostProcess
+{
+	PATH_POST_NONE = 0,
+	PATH_POST_COLLINEAR = 1 << 0,
+	PATH_POST_STRING_PULL = 1 << 1
+};
+
+// Drops the waypoints that don't change the direction of the path
+void RemoveCollinear(std::vector<iPoint>& path);
+
+// Drops the waypoints the previous kept one can see past
+void StringPull(std::vector<iPoint>& path, const SightMap& sight);
+
+// Spline through the waypoints, samples points per segment plus the last one. points
+// is refilled and keeps its capacity
+void CatmullRom(const std::vector<iPoint>& path, uint samples, std::vector<fPoint>& points);
+
+#endif // __PATHSMOOTH_H__
@@ -0,0 +1,71 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "j1App.h"
+#include "j1PathFinding.h"
+#include "PathQuadTree.h"
+#include "PathStream.h"
+
+StreamRequest::StreamRequest(uint id, const iPoint& origin, const iPoint& destination) :
+	id(id), origin(origin), destination(destination), path(1, origin)
+{}
+
+PathStreamer::PathStreamer()
+{}
+
+void PathStreamer::SetSegment(uint tiles)
+{
+	segment = MAX(tiles, 1);
+}
+
+bool PathStreamer::Route(StreamRequest& request, const QuadTree& quadtree)
+{
+	request.waypoints.clear();
+	request.next = 0;
+
+	if (quadtree.FindPath(request.path.back(), request.destination, coarse) == false)
+		return false;
+
+	for (uint i = segment; i + 1 < coarse.size(); i += segment)
+		request.waypoints.push_back(coarse[i]);
+	request.waypoints.push_back(request.destination);
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------
+// A failed segment gets one new route from the end of the path, failing again right
+// after it means the destination can't be reached anymore
+// ----------------------------------------------------------------------------------
+bool PathStreamer::RefineSegment(StreamRequest& request, const QuadTree& quadtree)
+{
+	if (request.finished == true)
+		return true;
+
+	if (request.path.back() == request.destination)
+	{
+		request.finished = true;
+		return true;
+	}
+
+	iPoint target = request.waypoints[request.next];
+	if (App->pathfinding->FindPathLanes(App->pathfinding->GetSearchContext(), request.path.back(), target, piece) == false)
+	{
+		if (request.rerouted == false && Route(request, quadtree) == true)
+		{
+			LOG("Streamed path %u: segment to %d,%d is cut, routing again", request.id, target.x, target.y);
+			request.rerouted = true;
+			return false;
+		}
+
+		request.failed = true;
+		request.finished = true;
+		return true;
+	}
+
+	request.path.insert(request.path.end(), piece.begin() + 1, piece.end());
+	request.rerouted = false;
+	request.next++;
+
+	request.finished = (request.next == request.waypoints.size());
+	return request.finished;
+}
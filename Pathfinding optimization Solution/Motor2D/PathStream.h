@@ -0,0 +1,73 @@
+#ifndef __PATHSTREAM_H__
+#define __PATHSTREAM_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+
+// coarse route tiles refined by each exact search
+#define DEFAULT_STREAM_SEGMENT 16
+#define DEFAULT_STREAM_BUDGET_MS 0.5f
+
+// --------------------------------------------------
+// Streamed paths
+// Botea, Mueller, Schaeffer: "Near Optimal Hierarchical Path-Finding" (HPA*)
+// A request first gets a coarse route over the leaves of the quadtree, which
+// is cheap even across the map, and cuts it into waypoints every few tiles.
+// Each waypoint is then reached with an exact A* from the end of the path
+// published so far, the first one before the request returns and the rest
+// over the next frames. Published tiles are never taken back: a unit can
+// follow them from the first frame while the rest streams in. A segment that
+// no longer connects because the map changed gets a new coarse route from
+// where the path ends.
+// --------------------------------------------------
+class QuadTree;
+
+// ---------------------------------------------------------------------
+// StreamRequest: one streamed query and what has been published
+// ---------------------------------------------------------------------
+struct StreamRequest
+{
+	StreamRequest(uint id, const iPoint& origin, const iPoint& destination);
+
+	uint id;
+	iPoint origin;
+	iPoint destination;
+	// tiles from origin, only ever appended to
+	std::vector<iPoint> path;
+	// coarse route still to refine, waypoints[next] first
+	std::vector<iPoint> waypoints;
+	uint next = 0;
+	bool rerouted = false;
+	bool finished = false;
+	// no path: path keeps what was published before
+	bool failed = false;
+};
+
+// ---------------------------------------------------------------------
+// PathStreamer: coarse routes and segment refinement
+// ---------------------------------------------------------------------
+class PathStreamer
+{
+public:
+
+	PathStreamer();
+
+	// Coarse route tiles each segment covers
+	void SetSegment(uint tiles);
+
+	// Coarse route from the end of the published path, false if there is none
+	bool Route(StreamRequest& request, const QuadTree& quadtree);
+
+	// Refines the next segment onto the published path, returns true once the request is finished
+	bool RefineSegment(StreamRequest& request, const QuadTree& quadtree);
+
+private:
+
+	uint segment = DEFAULT_STREAM_SEGMENT;
+	// scratch for the coarse route and the segment searches
+	std::vector<iPoint> coarse;
+	std::vector<iPoint> piece;
+};
+
+#endif // __PATHSTREAM_H__
@@ -0,0 +1,299 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "j1App.h"
+#include "j1PathFinding.h"
+#include "PathSymmetry.h"
+
+SymmetryReduction::SymmetryReduction()
+{}
+
+void SymmetryReduction::SetMap(uint width, uint height)
+{
+	CleanUp();
+
+	this->width = width;
+	this->height = height;
+	rect_of.assign(width*height, RSR_NONE);
+	Decompose(0, 0, width - 1, height - 1);
+
+	LOG("Symmetry reduction: %u rectangles over %u tiles", GetRectCount(), width*height);
+}
+
+void SymmetryReduction::CleanUp()
+{
+	rect_of.clear();
+	rects.clear();
+	free_rects.clear();
+	width = height = 0;
+}
+
+uint SymmetryReduction::GetRectCount() const
+{
+	return rects.size() - free_rects.size();
+}
+
+int SymmetryReduction::NewRect(int x, int y, int w, int h)
+{
+	Rect rect = { x, y, w, h };
+	int id;
+
+	if (free_rects.size() != 0)
+	{
+		id = free_rects.back();
+		free_rects.pop_back();
+		rects[id] = rect;
+	}
+	else
+	{
+		id = rects.size();
+		rects.push_back(rect);
+	}
+
+	for (int j = y; j < y + h; ++j)
+		std::fill(rect_of.begin() + (j * width) + x, rect_of.begin() + (j * width) + x + w, id);
+
+	return id;
+}
+
+// ----------------------------------------------------------------------------------
+// Greedy split of the free tiles in [x0, x1] x [y0, y1]: every rectangle grows
+// right and down while the tiles are free and share the same value
+// ----------------------------------------------------------------------------------
+void SymmetryReduction::Decompose(int x0, int y0, int x1, int y1)
+{
+	uint map_width, map_height;
+	const uchar* map = App->pathfinding->GetWalkabilityMap(map_width, map_height);
+
+	for (int y = y0; y <= y1; ++y)
+	{
+		for (int x = x0; x <= x1; ++x)
+		{
+			int tile = (y * width) + x;
+			uchar value = map[tile];
+
+			if (rect_of[tile] != RSR_NONE || value == INVALID_WALK_CODE || value == 0)
+				continue;
+
+			// grow right and down in turns, squares give the most interior tiles
+			int w = 1, h = 1;
+			bool grow_w = true, grow_h = true;
+			while (grow_w == true || grow_h == true)
+			{
+				if (grow_w == true)
+				{
+					grow_w = (x + w <= x1);
+					for (int j = 0; j < h && grow_w == true; ++j)
+						grow_w = (rect_of[tile + (j * width) + w] == RSR_NONE && map[tile + (j * width) + w] == value);
+
+					if (grow_w == true)
+						w++;
+				}
+
+				if (grow_h == true)
+				{
+					grow_h = (y + h <= y1);
+					for (int i = 0; i < w && grow_h == true; ++i)
+						grow_h = (rect_of[tile + (h * width) + i] == RSR_NONE && map[tile + (h * width) + i] == value);
+
+					if (grow_h == true)
+						h++;
+				}
+			}
+
+			NewRect(x, y, w, h);
+		}
+	}
+}
+
+// The rectangle that held the tile is dropped and its tiles split again, a tile
+// that just became walkable starts a rectangle of its own
+void SymmetryReduction::SetTile(const iPoint& pos)
+{
+	if (rect_of.size() == 0)
+		return;
+
+	int id = rect_of[(pos.y * width) + pos.x];
+
+	if (id != RSR_NONE)
+	{
+		Rect rect = rects[id];
+		for (int j = rect.y; j < rect.y + rect.h; ++j)
+			std::fill(rect_of.begin() + (j * width) + rect.x, rect_of.begin() + (j * width) + rect.x + rect.w, RSR_NONE);
+
+		free_rects.push_back(id);
+		Decompose(rect.x, rect.y, rect.x + rect.w - 1, rect.y + rect.h - 1);
+	}
+
+	Decompose(pos.x, pos.y, pos.x, pos.y);
+}
+
+bool SymmetryReduction::IsInterior(int x, int y) const
+{
+	int id = rect_of[(y * width) + x];
+	if (id == RSR_NONE)
+		return false;
+
+	const Rect& rect = rects[id];
+	return x > rect.x && x < rect.x + rect.w - 1 && y > rect.y && y < rect.y + rect.h - 1;
+}
+
+// Tiles after from up to to, diagonal steps first. Both ends share a rectangle
+// (or are neighbours) so every tile in between is free
+void SymmetryReduction::AppendSteps(const iPoint& from, const iPoint& to, std::vector<iPoint>& path_to_fill) const
+{
+	iPoint pos = from;
+
+	while (pos != to)
+	{
+		pos.x += (to.x > pos.x) ? 1 : ((to.x < pos.x) ? -1 : 0);
+		pos.y += (to.y > pos.y) ? 1 : ((to.y < pos.y) ? -1 : 0);
+		path_to_fill.push_back(pos);
+	}
+}
+
+// ----------------------------------------------------------------------------------
+// A* over perimeter tiles. Successors of a perimeter tile are its grid neighbours
+// that are not interior, the tiles of the opposite side it can reach with diagonal
+// steps and the ends of its diagonal runs across the rectangle. Any optimal path
+// inside a rectangle is a mix of those and straight moves along the perimeter
+// ----------------------------------------------------------------------------------
+bool SymmetryReduction::FindPath(SearchContext& context, const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const
+{
+	if (rect_of.size() == 0 || App->pathfinding->IsWalkable(origin) == false || App->pathfinding->IsWalkable(destination) == false)
+		return false;
+
+	uint map_width, map_height;
+	const uchar* map = App->pathfinding->GetWalkabilityMap(map_width, map_height);
+
+	context.Begin(width, height);
+
+	PathNode* firstNode = context.GetNode(origin.x, origin.y);
+	firstNode->g = 0;
+	firstNode->h = DefaultSearchPolicy::H(origin, destination);
+	firstNode->on_open = true;
+	context.PushOpen(firstNode);
+
+	int goal_rect = rect_of[(destination.y * width) + destination.x];
+	bool goal_interior = IsInterior(destination.x, destination.y);
+
+	PathNode* current;
+	while ((current = context.PopOpen()) != nullptr)
+	{
+		if (current->on_close == true)
+			continue;
+		current->on_close = true;
+
+		if (current->pos == destination)
+		{
+			// the parents are the perimeter tiles, the steps between them are filled in
+			path_to_fill.clear();
+			for (const PathNode* item = current; item != nullptr; item = item->parent)
+				path_to_fill.push_back(item->pos);
+			std::reverse(path_to_fill.begin(), path_to_fill.end());
+
+			uint corners = path_to_fill.size();
+			for (uint i = 1; i < corners; ++i)
+			{
+				iPoint from = path_to_fill[i - 1], to = path_to_fill[i];
+				AppendSteps(from, to, path_to_fill);
+			}
+			path_to_fill.erase(path_to_fill.begin() + 1, path_to_fill.begin() + corners);
+			return true;
+		}
+
+		iPoint pos = current->pos;
+		auto relax = [&](int x, int y, int cost)
+		{
+			PathNode* node = context.GetNode(x, y);
+			if (node->on_close == true)
+				return;
+
+			float g = current->g + cost;
+			if (node->on_open == false)
+			{
+				node->h = DefaultSearchPolicy::H(node->pos, destination);
+				node->on_open = true;
+			}
+			else if (g >= node->g)
+			{
+				return;
+			}
+
+			node->g = g;
+			node->parent = current;
+			context.PushOpen(node);
+		};
+		auto across = [&](int x, int y)
+		{
+			relax(x, y, DefaultSearchPolicy::H(pos, iPoint(x, y)));
+		};
+		auto neighbour = [&](int x, int y, int cost)
+		{
+			if (IsInterior(x, y) == false || (x == destination.x && y == destination.y))
+				relax(x, y, cost);
+		};
+		GridNeighbours<DefaultSearchPolicy>::Expand(map, width, height, pos.x, pos.y, neighbour);
+
+		int id = rect_of[(pos.y * width) + pos.x];
+		const Rect& rect = rects[id];
+		int right = rect.x + rect.w - 1, bottom = rect.y + rect.h - 1;
+
+		if (IsInterior(pos.x, pos.y) == true)
+		{
+			// only the origin can be inside a rectangle: link it to the whole perimeter
+			for (int x = rect.x; x <= right; ++x)
+			{
+				across(x, rect.y);
+				across(x, bottom);
+			}
+			for (int y = rect.y + 1; y < bottom; ++y)
+			{
+				across(rect.x, y);
+				across(right, y);
+			}
+		}
+		else
+		{
+			// opposite sides, closer than 2 tiles they are grid neighbours already
+			int depth = rect.h - 1;
+			if (depth > 1 && (pos.y == rect.y || pos.y == bottom))
+			{
+				int y = (pos.y == rect.y) ? bottom : rect.y;
+				for (int x = MAX(rect.x, pos.x - depth); x <= MIN(right, pos.x + depth); ++x)
+					across(x, y);
+			}
+
+			depth = rect.w - 1;
+			if (depth > 1 && (pos.x == rect.x || pos.x == right))
+			{
+				int x = (pos.x == rect.x) ? right : rect.x;
+				for (int y = MAX(rect.y, pos.y - depth); y <= MIN(bottom, pos.y + depth); ++y)
+					across(x, y);
+			}
+
+			for (uint dir = 4; dir < 8; ++dir)
+			{
+				int dx = grid_dirs[dir][0], dy = grid_dirs[dir][1];
+				int x = pos.x + dx, y = pos.y + dy, steps = 1;
+
+				if (x < rect.x || x > right || y < rect.y || y > bottom)
+					continue;
+
+				while (IsInterior(x, y) == true)
+				{
+					x += dx;
+					y += dy;
+					steps++;
+				}
+
+				if (steps > 1)
+					relax(x, y, DefaultSearchPolicy::Cost::DIAGONAL * steps);
+			}
+		}
+
+		if (goal_interior == true && id == goal_rect)
+			across(destination.x, destination.y);
+	}
+
+	return false;
+}
@@ -0,0 +1,65 @@
+#ifndef __PATHSYMMETRY_H__
+#define __PATHSYMMETRY_H__
+
+#include "p2Point.h"
+#include <vector>
+
+#define RSR_NONE -1
+
+// --------------------------------------------------
+// Rectangular Symmetry Reduction
+// Harabor, Botea, Kilby: "Path Symmetries in Uniform-cost Grid Maps"
+// The walkable area is split into empty rectangles of tiles with the same
+// walkability value. Searches only visit rectangle perimeters: inside a
+// rectangle every path between two perimeter tiles costs the octile distance,
+// so macro edges jump across it instead of expanding the symmetric interior.
+// --------------------------------------------------
+class SearchContext;
+
+// ---------------------------------------------------------------------
+// SymmetryReduction: the rectangles and the A* over their perimeters
+// ---------------------------------------------------------------------
+class SymmetryReduction
+{
+public:
+
+	SymmetryReduction();
+
+	// Splits the whole walkability map into rectangles
+	void SetMap(uint width, uint height);
+
+	// Releases the rectangles
+	void CleanUp();
+
+	// A tile changed: only the rectangle that held it is split again
+	void SetTile(const iPoint& pos);
+
+	// A* over perimeters, the path is filled tile by tile
+	bool FindPath(SearchContext& context, const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const;
+
+	// Number of rectangles in use
+	uint GetRectCount() const;
+
+private:
+
+	struct Rect
+	{
+		int x, y, w, h;
+	};
+
+	void Decompose(int x0, int y0, int x1, int y1);
+	int NewRect(int x, int y, int w, int h);
+	bool IsInterior(int x, int y) const;
+	void AppendSteps(const iPoint& from, const iPoint& to, std::vector<iPoint>& path_to_fill) const;
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	// rectangle of every tile, RSR_NONE for unwalkable ones
+	std::vector<int> rect_of;
+	std::vector<Rect> rects;
+	std::vector<int> free_rects;
+};
+
+#endif // __PATHSYMMETRY_H__
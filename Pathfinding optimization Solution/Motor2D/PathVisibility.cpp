@@ -0,0 +1,313 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "j1App.h"
+#include "j1PathFinding.h"
+#include "PathSight.h"
+#include "PathVisibility.h"
+#include <math.h>
+#include <functional>
+
+typedef GridNeighbours<DefaultSearchPolicy> Neighbours;
+
+static inline float Distance(const iPoint& a, const iPoint& b)
+{
+	float dx = (float)(b.x - a.x), dy = (float)(b.y - a.y);
+	return sqrtf((dx * dx) + (dy * dy));
+}
+
+VisibilityGraph::VisibilityGraph()
+{}
+
+void VisibilityGraph::CleanUp()
+{
+	corner_of.clear();
+	corners.clear();
+	alive.clear();
+	free_corners.clear();
+	edges.clear();
+	edges.shrink_to_fit();
+	width = height = max_corners = row_words = 0;
+	sight = nullptr;
+}
+
+bool VisibilityGraph::IsBuilt() const
+{
+	return corner_of.size() != 0;
+}
+
+uint VisibilityGraph::GetCornerCount() const
+{
+	return corners.size() - free_corners.size();
+}
+
+// A blocked diagonal neighbour whose two side tiles are walkable: a path can turn around it
+bool VisibilityGraph::IsCorner(const uchar* map, int x, int y) const
+{
+	if (Neighbours::Walkable(map, width, height, x, y) == false)
+		return false;
+
+	for (uint dir = 4; dir < 8; ++dir)
+	{
+		int dx = grid_dirs[dir][0], dy = grid_dirs[dir][1];
+		int cx = x + dx, cy = y + dy;
+
+		if (cx < 0 || cy < 0 || cx >= (int)width || cy >= (int)height)
+			continue;
+
+		if (Neighbours::Walkable(map, width, height, cx, cy) == false &&
+			Neighbours::Walkable(map, width, height, cx, y) == true &&
+			Neighbours::Walkable(map, width, height, x, cy) == true)
+			return true;
+	}
+
+	return false;
+}
+
+int VisibilityGraph::AddCorner(const iPoint& pos)
+{
+	int id;
+
+	if (free_corners.size() != 0)
+	{
+		id = free_corners.back();
+		free_corners.pop_back();
+		corners[id] = pos;
+		alive[id] = true;
+	}
+	else
+	{
+		id = corners.size();
+		corners.push_back(pos);
+		alive.push_back(true);
+	}
+
+	corner_of[(pos.y * width) + pos.x] = id;
+	return id;
+}
+
+void VisibilityGraph::RemoveCorner(int id)
+{
+	for (uint other = 0; other < corners.size(); ++other)
+		SetEdge(id, other, false);
+
+	corner_of[(corners[id].y * width) + corners[id].x] = VISIBILITY_NONE;
+	alive[id] = false;
+	free_corners.push_back(id);
+}
+
+void VisibilityGraph::SetEdge(int a, int b, bool visible)
+{
+	uint64 bit_b = (uint64)1 << (b & 63), bit_a = (uint64)1 << (a & 63);
+
+	if (visible == true)
+	{
+		edges[(a * row_words) + (b >> 6)] |= bit_b;
+		edges[(b * row_words) + (a >> 6)] |= bit_a;
+	}
+	else
+	{
+		edges[(a * row_words) + (b >> 6)] &= ~bit_b;
+		edges[(b * row_words) + (a >> 6)] &= ~bit_a;
+	}
+}
+
+void VisibilityGraph::SetMap(uint width, uint height, const uchar* map, const SightMap* sight, uint max_corners)
+{
+	CleanUp();
+
+	this->width = width;
+	this->height = height;
+	this->sight = sight;
+	this->max_corners = max_corners;
+	row_words = (max_corners + 63) / 64;
+	corner_of.assign(width*height, VISIBILITY_NONE);
+
+	for (uint y = 0; y < height; ++y)
+	{
+		for (uint x = 0; x < width; ++x)
+		{
+			if (IsCorner(map, x, y) == false)
+				continue;
+
+			if (corners.size() == max_corners)
+			{
+				LOG("Visibility graph: more than %u corners, the map is not sparse enough", max_corners);
+				CleanUp();
+				return;
+			}
+
+			AddCorner(iPoint(x, y));
+		}
+	}
+
+	edges.assign(max_corners * row_words, 0);
+
+	uint edge_count = 0;
+	for (uint a = 0; a < corners.size(); ++a)
+	{
+		for (uint b = a + 1; b < corners.size(); ++b)
+		{
+			if (sight->Clear(corners[a], corners[b]) == true)
+			{
+				SetEdge(a, b, true);
+				edge_count++;
+			}
+		}
+	}
+
+	LOG("Visibility graph: %u corners, %u edges", corners.size(), edge_count);
+}
+
+// ----------------------------------------------------------------------------------
+// Only a tile of the 3x3 block around pos can gain or lose its corner, and only a
+// segment whose bounding box (one tile wider) holds pos can cross it
+// ----------------------------------------------------------------------------------
+void VisibilityGraph::SetTile(const iPoint& pos, const uchar* map)
+{
+	if (IsBuilt() == false)
+		return;
+
+	std::vector<int> created;
+	for (int y = MAX(pos.y - 1, 0); y <= MIN(pos.y + 1, (int)height - 1); ++y)
+	{
+		for (int x = MAX(pos.x - 1, 0); x <= MIN(pos.x + 1, (int)width - 1); ++x)
+		{
+			int id = corner_of[(y * width) + x];
+			bool corner = IsCorner(map, x, y);
+
+			if (id != VISIBILITY_NONE && corner == false)
+			{
+				RemoveCorner(id);
+			}
+			else if (id == VISIBILITY_NONE && corner == true)
+			{
+				if (GetCornerCount() == max_corners)
+				{
+					LOG("Visibility graph: more than %u corners after tile %d,%d changed, dropping it", max_corners, pos.x, pos.y);
+					CleanUp();
+					return;
+				}
+				created.push_back(AddCorner(iPoint(x, y)));
+			}
+		}
+	}
+
+	for (uint a = 0; a < corners.size(); ++a)
+	{
+		if (alive[a] == false)
+			continue;
+
+		bool a_created = std::find(created.begin(), created.end(), a) != created.end();
+		for (uint b = a + 1; b < corners.size(); ++b)
+		{
+			if (alive[b] == false)
+				continue;
+
+			const iPoint& from = corners[a];
+			const iPoint& to = corners[b];
+			bool near = pos.x >= MIN(from.x, to.x) - 1 && pos.x <= MAX(from.x, to.x) + 1 &&
+				pos.y >= MIN(from.y, to.y) - 1 && pos.y <= MAX(from.y, to.y) + 1;
+
+			if (near == true || a_created == true || std::find(created.begin(), created.end(), b) != created.end())
+				SetEdge(a, b, sight->Clear(from, to));
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------------
+// A* over the corners plus origin and destination, linked to the corners they see.
+// Scores are straight distances, so the path is the shortest any-angle one
+// ----------------------------------------------------------------------------------
+bool VisibilityGraph::FindPath(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const
+{
+	typedef std::pair<float, int> Entry;
+
+	if (IsBuilt() == false || App->pathfinding->IsWalkable(origin) == false || App->pathfinding->IsWalkable(destination) == false)
+		return false;
+
+	if (sight->Clear(origin, destination) == true)
+	{
+		path_to_fill.clear();
+		path_to_fill.push_back(origin);
+		if (destination != origin)
+			path_to_fill.push_back(destination);
+		return true;
+	}
+
+	// corners are 0..count-1, then origin and destination
+	int count = corners.size();
+	int start = count, goal = count + 1;
+	std::vector<float> g(count + 2, -1.0f);
+	std::vector<int> came_from(count + 2, VISIBILITY_NONE);
+	std::vector<bool> closed(count + 2, false);
+	std::vector<bool> sees_goal(count, false);
+	std::vector<Entry> open;
+
+	for (int i = 0; i < count; ++i)
+		sees_goal[i] = alive[i] == true && sight->Clear(corners[i], destination);
+
+	auto position = [&](int node) { return (node < count) ? corners[node] : ((node == start) ? origin : destination); };
+	auto relax = [&](int from, int to)
+	{
+		if (closed[to] == true)
+			return;
+
+		iPoint to_pos = position(to);
+		float new_g = g[from] + Distance(position(from), to_pos);
+		if (g[to] >= 0.0f && new_g >= g[to])
+			return;
+
+		g[to] = new_g;
+		came_from[to] = from;
+		open.push_back(Entry(new_g + Distance(to_pos, destination), to));
+		std::push_heap(open.begin(), open.end(), std::greater<Entry>());
+	};
+
+	g[start] = 0.0f;
+	open.push_back(Entry(Distance(origin, destination), start));
+
+	while (open.size() != 0)
+	{
+		std::pop_heap(open.begin(), open.end(), std::greater<Entry>());
+		int current = open.back().second;
+		open.pop_back();
+
+		if (closed[current] == true)
+			continue;
+		closed[current] = true;
+
+		if (current == goal)
+		{
+			path_to_fill.clear();
+			for (int node = goal; node != VISIBILITY_NONE; node = came_from[node])
+				path_to_fill.push_back(position(node));
+			std::reverse(path_to_fill.begin(), path_to_fill.end());
+			return true;
+		}
+
+		if (current == start)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				if (alive[i] == true && sight->Clear(origin, corners[i]) == true)
+					relax(start, i);
+			}
+			continue;
+		}
+
+		for (uint word = 0; word < row_words; ++word)
+		{
+			uint64 bits = edges[(current * row_words) + word];
+			for (uint bit = 0; bits != 0; ++bit, bits >>= 1)
+			{
+				if ((bits & 1) != 0)
+					relax(current, (word << 6) + bit);
+			}
+		}
+
+		if (sees_goal[current] == true)
+			relax(current, goal);
+	}
+
+	return false;
+}
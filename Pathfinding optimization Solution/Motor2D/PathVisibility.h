@@ -0,0 +1,79 @@
+#ifndef __PATHVISIBILITY_H__
+#define __PATHVISIBILITY_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <vector>
+
+#define VISIBILITY_NONE -1
+
+// --------------------------------------------------
+// Visibility graph over obstacle corners
+// Lozano-Perez, Wesley: "An Algorithm for Planning Collision-Free Paths Among
+// Polyhedral Obstacles"
+// The vertices are the walkable tiles at a convex corner of a blocked region,
+// the edges every pair of them with line of sight. Any-angle shortest paths
+// only turn at those corners, so a query links origin and destination to the
+// corners they see and runs A* over a few hundred vertices. Edges are a bit
+// matrix sized for the corner limit.
+// --------------------------------------------------
+class SightMap;
+
+// ---------------------------------------------------------------------
+// VisibilityGraph: corners, their visibility and the any-angle search
+// ---------------------------------------------------------------------
+class VisibilityGraph
+{
+public:
+
+	VisibilityGraph();
+
+	// Finds the corners and sweeps line of sight between every pair, the graph
+	// stays empty if there are more than max_corners
+	void SetMap(uint width, uint height, const uchar* map, const SightMap* sight, uint max_corners);
+
+	// Releases the graph
+	void CleanUp();
+
+	bool IsBuilt() const;
+
+	// A tile changed (the sight map must be updated first): corners around it are
+	// redone and only the edges that can pass over it are tested again
+	void SetTile(const iPoint& pos, const uchar* map);
+
+	// Any-angle path, path_to_fill gets the waypoints
+	bool FindPath(const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const;
+
+	// Number of corners in use
+	uint GetCornerCount() const;
+
+private:
+
+	bool IsCorner(const uchar* map, int x, int y) const;
+	int AddCorner(const iPoint& pos);
+	void RemoveCorner(int id);
+	void SetEdge(int a, int b, bool visible);
+
+	inline bool Edge(int a, int b) const
+	{
+		return ((edges[(a * row_words) + (b >> 6)] >> (b & 63)) & 1) != 0;
+	}
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	uint max_corners = 0;
+	uint row_words = 0;
+	const SightMap* sight = nullptr;
+
+	// corner of every tile, VISIBILITY_NONE for the rest
+	std::vector<int> corner_of;
+	std::vector<iPoint> corners;
+	std::vector<bool> alive;
+	std::vector<int> free_corners;
+	// max_corners rows of row_words, bit b of row a is the edge a-b
+	std::vector<uint64> edges;
+};
+
+#endif // __PATHVISIBILITY_H__
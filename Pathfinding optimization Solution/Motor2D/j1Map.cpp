@@ -68,6 +68,33 @@ bool j1Map::CreateWalkabilityMap(int& width, int & height, uchar** buffer) {
 	return ret;
 
 }
+
+bool j1Map::CreateRoomMap(std::vector<SDL_Rect>& rooms, std::vector<SDL_Rect>& portals) const
+{
+	rooms.clear();
+	portals.clear();
+
+	std::list<MapObjectGroup*>::const_iterator item;
+	for (item = data.object_groups.begin(); item != data.object_groups.end(); item++)
+	{
+		const MapObjectGroup* group = *item;
+
+		if (group->properties.Get("Navigation") == false)
+			continue;
+
+		std::list<MapObject*>::const_iterator object;
+		for (object = group->objects.begin(); object != group->objects.end(); object++)
+		{
+			if ((*object)->type == "room")
+				rooms.push_back((*object)->rect);
+			else if ((*object)->type == "portal")
+				portals.push_back((*object)->rect);
+		}
+	}
+
+	return rooms.size() != 0;
+}
+
 void j1Map::Draw()
 {
 	if (map_loaded == false)
@@ -162,6 +189,29 @@ iPoint j1Map::MapToWorld(int x, int y) const
 	return ret;
 }
 
+fPoint j1Map::MapToWorld(float x, float y) const
+{
+	fPoint ret;
+
+	if (data.type == MAPTYPE_ORTHOGONAL)
+	{
+		ret.x = x * data.tile_width;
+		ret.y = y * data.tile_height;
+	}
+	else if (data.type == MAPTYPE_ISOMETRIC)
+	{
+		ret.x = (x - y) * (int)(data.tile_width * 0.5f);
+		ret.y = (x + y) * (int)(data.tile_height * 0.5f);
+	}
+	else
+	{
+		LOG("Unknown map type");
+		ret.x = x; ret.y = y;
+	}
+
+	return ret;
+}
+
 iPoint j1Map::WorldToMap(int x, int y) const
 {
 	iPoint ret(0, 0);
@@ -224,6 +274,16 @@ bool j1Map::CleanUp()
 	}
 	data.layers.clear();
 
+	// Remove all object groups
+	std::list<MapObjectGroup*>::iterator item3 = data.object_groups.begin();
+
+	while (item3 != data.object_groups.end())
+	{
+		RELEASE(*item3);
+		item3++;
+	}
+	data.object_groups.clear();
+
 	// Clean up the pugui tree
 	map_file.reset();
 
@@ -285,6 +345,18 @@ bool j1Map::Load(const char* file_name)
 			data.layers.push_back(lay);
 	}
 
+	// Load object groups ---------------------------------------------
+	pugi::xml_node objectgroup;
+	for (objectgroup = map_file.child("map").child("objectgroup"); objectgroup && ret; objectgroup = objectgroup.next_sibling("objectgroup"))
+	{
+		MapObjectGroup* group = new MapObjectGroup();
+
+		ret = LoadObjectGroup(objectgroup, group);
+
+		if (ret == true)
+			data.object_groups.push_back(group);
+	}
+
 	if (ret == true)
 	{
 		LOG("Successfully parsed map XML file: %s", file_name);
@@ -311,6 +383,15 @@ bool j1Map::Load(const char* file_name)
 			LOG("tile width: %d tile height: %d", l->width, l->height);
 			item_layer++;
 		}
+
+		std::list<MapObjectGroup*>::iterator item_group = data.object_groups.begin();
+		while (item_group != data.object_groups.end())
+		{
+			MapObjectGroup* g = *item_group;
+			LOG("Object group ----");
+			LOG("name: %s objects: %u", g->name.c_str(), (uint)g->objects.size());
+			item_group++;
+		}
 	}
 
 	map_loaded = ret;
@@ -451,6 +532,37 @@ bool j1Map::LoadLayer(pugi::xml_node& node, MapLayer* layer)
 	return ret;
 }
 
+// Object positions are in pixels: tile_width x tile_height units on orthogonal maps,
+// tile_height on both axes on isometric ones
+bool j1Map::LoadObjectGroup(pugi::xml_node& node, MapObjectGroup* group)
+{
+	bool ret = true;
+
+	group->name = node.attribute("name").as_string();
+	LoadProperties(node, group->properties);
+
+	float unit_x = (data.type == MAPTYPE_ISOMETRIC) ? (float)data.tile_height : (float)data.tile_width;
+	float unit_y = (float)data.tile_height;
+
+	for (pugi::xml_node object = node.child("object"); object; object = object.next_sibling("object"))
+	{
+		MapObject* o = new MapObject();
+
+		o->name = object.attribute("name").as_string();
+		o->type = object.attribute("type").as_string();
+
+		float x = object.attribute("x").as_float();
+		float y = object.attribute("y").as_float();
+		o->rect.x = (int)floorf(x / unit_x);
+		o->rect.y = (int)floorf(y / unit_y);
+		o->rect.w = MAX((int)ceilf((x + object.attribute("width").as_float()) / unit_x) - o->rect.x, 1);
+		o->rect.h = MAX((int)ceilf((y + object.attribute("height").as_float()) / unit_y) - o->rect.y, 1);
+
+		group->objects.push_back(o);
+	}
+
+	return ret;
+}
 
 bool j1Map::LoadProperties(pugi::xml_node& node, Properties& properties)
 {
@@ -5,6 +5,7 @@
 #include "p2List.h"
 #include "p2Point.h"
 #include "j1Module.h"
+#include <vector>
 
 // ----------------------------------------------------
 struct Properties
@@ -56,6 +57,36 @@ struct MapLayer
 	}
 };
 
+// ----------------------------------------------------
+struct MapObject
+{
+	std::string	name;
+	std::string	type;
+	// in tiles, covering every tile the object touches
+	SDL_Rect	rect;
+};
+
+// ----------------------------------------------------
+struct MapObjectGroup
+{
+	std::string				name;
+	Properties				properties;
+	std::list<MapObject*>	objects;
+
+	~MapObjectGroup()
+	{
+		std::list<MapObject*>::iterator item = objects.begin();
+
+		while (item != objects.end())
+		{
+			RELEASE(*item);
+			item++;
+		}
+
+		objects.clear();
+	}
+};
+
 // ----------------------------------------------------
 struct TileSet
 {
@@ -94,6 +125,7 @@ struct MapData
 	MapTypes			type;
 	std::list<TileSet*>	tilesets;
 	std::list<MapLayer*>	layers;
+	std::list<MapObjectGroup*>	object_groups;
 };
 
 // ----------------------------------------------------
@@ -119,8 +151,12 @@ public:
 	bool Load(const char* path);
 
 	iPoint MapToWorld(int x, int y) const;
+	// Same for points between tile positions, like path curves
+	fPoint MapToWorld(float x, float y) const;
 	iPoint WorldToMap(int x, int y) const;
 	bool CreateWalkabilityMap(int& width, int& height, uchar** buffer);
+	// rooms and portals of the object groups with the Navigation property
+	bool CreateRoomMap(std::vector<SDL_Rect>& rooms, std::vector<SDL_Rect>& portals) const;
 
 private:
 
@@ -128,6 +164,7 @@ private:
 	bool LoadTilesetDetails(pugi::xml_node& tileset_node, TileSet* set);
 	bool LoadTilesetImage(pugi::xml_node& tileset_node, TileSet* set);
 	bool LoadLayer(pugi::xml_node& node, MapLayer* layer);
+	bool LoadObjectGroup(pugi::xml_node& node, MapObjectGroup* group);
 	bool LoadProperties(pugi::xml_node& node, Properties& properties);
 
 	TileSet* GetTilesetFromTileId(int id) const;
@@ -4,16 +4,137 @@
 #include "j1PathFinding.h"
 #include "j1Render.h"
 #include "j1Input.h"
+#include "PathAnytime.h"
+#include "PathAdaptive.h"
+#include "PathParallel.h"
+#include "PathBounded.h"
+#include "PathSight.h"
+#include "PathSymmetry.h"
+#include "PathDatabase.h"
+#include "PathGoalBounds.h"
+#include "PathDeadEnds.h"
+#include "PathRooms.h"
+#include "PathNavMesh.h"
+#include "PathVisibility.h"
+#include "PathQuadTree.h"
+#include "PathSelector.h"
+#include "PathSmooth.h"
+#include "PathCompact.h"
+#include "PathGroup.h"
+#include "SDL\include\SDL_cpuinfo.h"
 
 j1PathFinding::j1PathFinding() : j1Module(), map(NULL), last_path(DEFAULT_PATH_LENGTH),width(0), height(0)
 {
 	name.assign("pathfinding");
+	paths = new PathArena();
+	anytime = new AnytimeSearch();
+	streamer = new PathStreamer();
+	group = new GroupPlanner();
+	adaptive = new AdaptiveSearch();
+	parallel = new ParallelSearch();
+	bounded = new BoundedSearch();
+	sight = new SightMap();
+	sight_workers = new SightWorkers();
+	visibility = new VisibilityGraph();
+	symmetry = new SymmetryReduction();
+	dead_ends = new DeadEnds();
+	rooms = new RoomGraph();
+	navmesh = new NavMesh();
+	quadtree = new QuadTree();
+	selector = new PathSelector();
+	database = new PathDatabase();
+	goal_bounds = new GoalBounds();
 }
 
 // Destructor
 j1PathFinding::~j1PathFinding()
 {
 	RELEASE_ARRAY(map);
+	RELEASE(paths);
+	RELEASE(anytime);
+	RELEASE(streamer);
+	RELEASE(group);
+	RELEASE(adaptive);
+	RELEASE(parallel);
+	RELEASE(bounded);
+	RELEASE(sight_workers);
+	RELEASE(sight);
+	RELEASE(visibility);
+	RELEASE(symmetry);
+	RELEASE(dead_ends);
+	RELEASE(rooms);
+	RELEASE(navmesh);
+	RELEASE(quadtree);
+	RELEASE(selector);
+	RELEASE(database);
+	RELEASE(goal_bounds);
+}
+
+// Called before render is available
+bool j1PathFinding::Awake(pugi::xml_node& config)
+{
+	LOG("Loading Pathfinding");
+
+	pugi::xml_node anytime_config = config.child("anytime");
+	anytime_budget_ms = anytime_config.attribute("budget_ms").as_float(DEFAULT_ANYTIME_BUDGET_MS);
+	anytime_first_budget_ms = anytime_config.attribute("first_budget_ms").as_float(DEFAULT_ANYTIME_FIRST_BUDGET_MS);
+
+	pugi::xml_node stream_config = config.child("stream");
+	stream_budget_ms = stream_config.attribute("budget_ms").as_float(DEFAULT_STREAM_BUDGET_MS);
+	streamer->SetSegment(stream_config.attribute("segment").as_uint(DEFAULT_STREAM_SEGMENT));
+
+	pugi::xml_node group_config = config.child("group");
+	group->SetSpacing(group_config.attribute("spacing").as_uint(DEFAULT_GROUP_SPACING));
+	group->SetLocalExpansions(group_config.attribute("local_expansions").as_uint(DEFAULT_GROUP_LOCAL_EXPANSIONS));
+
+	pugi::xml_node memory_config = config.child("memory");
+	max_node_map_tiles = memory_config.attribute("max_node_map_tiles").as_uint(DEFAULT_MAX_NODE_MAP_TILES);
+	bounded->SetTableSize(memory_config.attribute("table_size").as_uint(DEFAULT_BOUNDED_TABLE_SIZE));
+
+	adaptive->SetMaxGoals(config.child("adaptive").attribute("goals").as_uint(DEFAULT_ADAPTIVE_GOALS));
+	parallel->SetThreads(config.child("parallel").attribute("threads").as_uint(DEFAULT_PARALLEL_THREADS));
+	visibility_max_corners = config.child("visibility").attribute("max_corners").as_uint(DEFAULT_VISIBILITY_MAX_CORNERS);
+	selector->SetExploreEvery(config.child("selector").attribute("explore_every").as_uint(DEFAULT_SELECTOR_EXPLORE_EVERY));
+	database_file = config.child("database").attribute("file").as_string("");
+	goal_bounds_file = config.child("goal_bounds").attribute("file").as_string("");
+
+	const char* kernel_name;
+	expand_kernel = SelectExpandKernel(&kernel_name);
+	LOG("Pathfinding expansion kernel: %s", kernel_name);
+
+	return true;
+}
+
+// Called each loop iteration
+bool j1PathFinding::Update(float dt)
+{
+	// refine anytime paths in request order while there is frame budget left
+	j1PerfTimer timer;
+	std::list<AnytimeRequest*>::iterator item = anytime_requests.begin();
+
+	while (item != anytime_requests.end())
+	{
+		double remaining = anytime_budget_ms - timer.ReadMs();
+		if (remaining <= 0)
+			break;
+
+		if ((*item)->finished == false && anytime->Improve(**item, remaining) == false)
+			break;
+
+		item++;
+	}
+
+	// then streamed paths, one segment at a time
+	j1PerfTimer stream_timer;
+	std::list<StreamRequest*>::iterator stream = stream_requests.begin();
+
+	while (stream != stream_requests.end() && stream_timer.ReadMs() < stream_budget_ms)
+	{
+		if (streamer->RefineSegment(**stream, *quadtree) == true)
+			stream++;
+	}
+
+	return true;
 }
 
 // Called before quitting
@@ -22,7 +143,42 @@ bool j1PathFinding::CleanUp()
 	LOG("Freeing pathfinding library");
 
 	last_path.clear();
+	paths->Clear();
 	RELEASE_ARRAY(map);
+	lane_map.clear();
+	lane_map.shrink_to_fit();
+	contexts.Clear();
+	bounded->CleanUp();
+	adaptive->CleanUp();
+	parallel->CleanUp();
+	sight_workers->Stop();
+	sight->CleanUp();
+	visibility->CleanUp();
+	symmetry->CleanUp();
+	dead_ends->CleanUp();
+	rooms->CleanUp();
+	navmesh->CleanUp();
+	quadtree->CleanUp();
+	database->CleanUp();
+	goal_bounds->CleanUp();
+
+	for (uint i = 0; i < PATH_ENGINE_COUNT; ++i)
+	{
+		const EngineStats& stats = selector->GetStats((PathEngine)i);
+		if (stats.queries != 0)
+			LOG("Path engine %s: %u queries, %.3f ms mean, %.3f ms worst", PathSelector::GetEngineName((PathEngine)i), stats.queries, stats.total_ms / stats.queries, stats.worst_ms);
+	}
+	selector->CleanUp();
+
+	std::list<AnytimeRequest*>::iterator item = anytime_requests.begin();
+	while (item != anytime_requests.end())
+	{
+		RELEASE(*item);
+		item++;
+	}
+	anytime_requests.clear();
+	anytime->CleanUp();
+	ReleaseStreamRequests();
 	return true;
 }
 
@@ -35,17 +191,144 @@ void j1PathFinding::SetMap(uint width, uint height, uchar* data)
 	RELEASE_ARRAY(map);
 	map = new uchar[width*height];
 	//TODO1
-	//create a node_map
-	node_map = new PathNode[width*height];
+	//node maps live in the search contexts and grow to the map size on their next search
+	memory_bounded = (width*height > max_node_map_tiles);
+	if (memory_bounded == true)
+		LOG("Map of %u tiles is over the node map limit, using memory bounded searches", width*height);
 
 	memcpy(map, data, width*height);
+
+	// padded copy for the expansion kernel, 4 spare bytes so it can be read as ints
+	lane_map.clear();
+	if (memory_bounded == false)
+	{
+		uint row = width + 2;
+		lane_map.resize(row * (height + 2) + 4, 0);
+		for (uint y = 0; y < height; ++y)
+			memcpy(&lane_map[(y + 1) * row + 1], &map[y * width], width);
+
+		for (uint dir = 0; dir < LANE_NEIGHBOURS; ++dir)
+			lane_offsets[dir] = grid_dirs[dir][1] * (int)row + grid_dirs[dir][0];
+	}
+	lane_map.shrink_to_fit();
+
+	sight->SetMap(width, height, map);
+	if (memory_bounded == false)
+		visibility->SetMap(width, height, map, sight, visibility_max_corners);
+	else
+		visibility->CleanUp();
+
+	if (memory_bounded == false)
+	{
+		symmetry->SetMap(width, height);
+		dead_ends->SetMap(width, height, map);
+		navmesh->SetMap(width, height, map);
+		quadtree->SetMap(width, height, map);
+		selector->SetMap(width, height, map);
+		adaptive->SetMap(width, height);
+		parallel->SetMap(width, height);
+		bounded->ClearComponents();
+	}
+	else
+	{
+		bounded->SetMap(width, height, map);
+		symmetry->CleanUp();
+		dead_ends->CleanUp();
+		navmesh->CleanUp();
+		quadtree->CleanUp();
+		selector->CleanUp();
+		adaptive->CleanUp();
+		parallel->CleanUp();
+	}
+
+	// rooms belong to the previous map until SetRooms
+	rooms->CleanUp();
+
+	if (database_file.size() != 0)
+		database->Load(database_file.c_str(), width, height, map);
+	else
+		database->CleanUp();
+
+	// a missing or stale cache is rebuilt, only the lane searches use the boxes
+	goal_bounds->CleanUp();
+	if (goal_bounds_file.size() != 0 && memory_bounded == false &&
+		goal_bounds->Load(goal_bounds_file.c_str(), width, height, map) == false &&
+		goal_bounds->Build(width, height, map) == true)
+		goal_bounds->Save(goal_bounds_file.c_str());
+
+	// anytime requests belong to the previous map
+	std::list<AnytimeRequest*>::iterator item = anytime_requests.begin();
+	while (item != anytime_requests.end())
+	{
+		RELEASE(*item);
+		item++;
+	}
+	anytime_requests.clear();
+	ReleaseStreamRequests();
+	if (memory_bounded == false)
+		anytime->SetMap(width, height);
+	else
+		anytime->CleanUp();
+}
+
+// Changes a single tile, everything built from the map is updated around it
+void j1PathFinding::SetTileAt(const iPoint& pos, uchar value)
+{
+	if (CheckBoundaries(pos) == false)
+		return;
+
+	bool opened = (IsWalkable(pos) == false);
+	map[(pos.y*width) + pos.x] = value;
+	opened = (opened == true && IsWalkable(pos) == true);
+
+	if (memory_bounded == false)
+	{
+		lane_map[(pos.y + 1) * (width + 2) + pos.x + 1] = value;
+		symmetry->SetTile(pos);
+		dead_ends->SetTile(pos, map);
+		navmesh->SetTile(pos, map);
+		quadtree->SetTile(pos, map);
+		selector->SetTile(pos, map);
+		adaptive->SetTile(opened);
+	}
+	else
+	{
+		bounded->SetTile(pos, map);
+	}
+
+	sight->SetTile(pos, IsWalkable(pos));
+	visibility->SetTile(pos, map);
+
+	// the tables were built for the old map
+	if (database->IsLoaded() == true)
+	{
+		LOG("Tile %d,%d changed, dropping the path database", pos.x, pos.y);
+		database->CleanUp();
+	}
+
+	if (goal_bounds->IsLoaded() == true)
+	{
+		LOG("Tile %d,%d changed, dropping the goal bounds", pos.x, pos.y);
+		goal_bounds->CleanUp();
+	}
+
+	// searches in progress were made over the old tile
+	anytime->Reset();
+}
+
+void j1PathFinding::SetRooms(const std::vector<SDL_Rect>& rooms, const std::vector<SDL_Rect>& portals)
+{
+	if (memory_bounded == false)
+		this->rooms->SetRooms(width, height, rooms, portals);
+	else
+		this->rooms->CleanUp();
 }
 
 // Utility: return true if pos is inside the map boundaries
 bool j1PathFinding::CheckBoundaries(const iPoint& pos) const
 {
-	return (pos.x >= 0 && pos.x <= (int)width &&
-			pos.y >= 0 && pos.y <= (int)height);
+	return (pos.x >= 0 && pos.x < (int)width &&
+			pos.y >= 0 && pos.y < (int)height);
 }
 
 // Utility: returns true is the tile is walkable
@@ -64,12 +347,360 @@ uchar j1PathFinding::GetTileAt(const iPoint& pos) const
 	return INVALID_WALK_CODE;
 }
 
+// Utility: raw walkability map for the search kernels
+const uchar* j1PathFinding::GetWalkabilityMap(uint& width, uint& height) const
+{
+	width = this->width;
+	height = this->height;
+	return map;
+}
+
 // To request all tiles involved in the last generated path
 const std::vector<iPoint>* j1PathFinding::GetLastPath() const
 {
 	return &last_path;
 }
 
+// ----------------------------------------------------------------------------------
+// The search backtracks straight into the slot vector, a failed search gives the
+// slot back at once
+// ----------------------------------------------------------------------------------
+PathHandle j1PathFinding::RequestPath(const iPoint& origin, const iPoint& destination)
+{
+	std::vector<iPoint>* path;
+	PathHandle handle = paths->Acquire(path);
+	if (handle == PATH_HANDLE_NONE)
+		return PATH_HANDLE_NONE;
+
+	bool found = false;
+	if (memory_bounded == false)
+	{
+		found = FindPathLanes(GetSearchContext(), origin, destination, *path);
+	}
+	else if (IsWalkable(origin) == true && IsWalkable(destination) == true)
+	{
+		// no node map on huge maps: fringe search, and IDA* if its table fills up
+		found = bounded->FindPathFringe(origin, destination, *path);
+		if (found == false && bounded->FringeOverflowed() == true)
+		{
+			path->clear();
+			found = bounded->FindPathIDA(origin, destination, *path);
+		}
+	}
+
+	if (found == false)
+	{
+		paths->Release(handle);
+		return PATH_HANDLE_NONE;
+	}
+
+	return handle;
+}
+
+PathSpan j1PathFinding::GetPath(PathHandle handle) const
+{
+	return paths->Get(handle);
+}
+
+void j1PathFinding::ReleasePath(PathHandle handle)
+{
+	paths->Release(handle);
+}
+
+// ----------------------------------------------------------------------------------
+// One search for the leader and the formation for everyone else, see PathGroup.h.
+// The leader heads for the closest tile its component has to the destination.
+// Without a node map every unit searches on its own
+// ----------------------------------------------------------------------------------
+bool j1PathFinding::RequestGroupPath(const std::vector<iPoint>& units, const iPoint& destination, std::vector<PathHandle>& handles, GroupStats* stats)
+{
+	handles.assign(units.size(), PATH_HANDLE_NONE);
+	if (units.size() == 0)
+		return false;
+
+	if (memory_bounded == true)
+	{
+		bool found = false;
+		for (uint i = 0; i < units.size(); ++i)
+		{
+			handles[i] = RequestPath(units[i], destination);
+			found |= handles[i] != PATH_HANDLE_NONE;
+		}
+		return found;
+	}
+
+	SearchContext& context = GetSearchContext();
+	GroupStats order_stats;
+
+	iPoint origin = group->LeaderOrigin(map, width, height, units);
+	iPoint target;
+	bool found = false;
+	for (uint attempt = 0; attempt < 2 && found == false; ++attempt)
+	{
+		if (FindNearestReachable(origin, destination, target) == false)
+			return false;
+
+		order_stats.full_searches++;
+		found = FindPathLanes(context, origin, target, group_leader);
+
+		// a closed tile split the component after it was labelled, the next
+		// Connected relabels it
+		if (found == false)
+			selector->Disconnected();
+	}
+
+	if (found == false)
+		return false;
+
+	group_paths.resize(units.size());
+	for (uint i = 0; i < units.size(); ++i)
+	{
+		handles[i] = paths->Acquire(group_paths[i]);
+		if (handles[i] == PATH_HANDLE_NONE)
+		{
+			for (uint j = 0; j < i; ++j)
+				paths->Release(handles[j]);
+			handles.assign(units.size(), PATH_HANDLE_NONE);
+			return false;
+		}
+	}
+
+	group->Plan(context, map, width, height, group_leader, units, group_paths, order_stats);
+
+	for (uint i = 0; i < units.size(); ++i)
+	{
+		if (group_paths[i]->size() == 0)
+		{
+			paths->Release(handles[i]);
+			handles[i] = PATH_HANDLE_NONE;
+		}
+	}
+
+	if (stats != nullptr)
+		*stats = order_stats;
+
+	return true;
+}
+
+bool j1PathFinding::GetLastPathCompact(CompactPath& path) const
+{
+	return path.Encode(last_path);
+}
+
+void j1PathFinding::PostProcess(std::vector<iPoint>& path, uint steps) const
+{
+	if ((steps & PATH_POST_COLLINEAR) != 0)
+		RemoveCollinear(path);
+
+	if ((steps & PATH_POST_STRING_PULL) != 0)
+		StringPull(path, *sight);
+}
+
+void j1PathFinding::PostProcessLastPath(uint steps)
+{
+	PostProcess(last_path, steps);
+}
+
+// Anytime paths ----------------------------------------------------------------------
+// Creates the request and spends the first budget on it, with a big enough
+// epsilon the first path is usually there when this returns
+// ---------------------------------------------------------------------------------
+uint j1PathFinding::CreatePathAnytime(const iPoint& origin, const iPoint& destination, float epsilon)
+{
+	if (IsMemoryBounded() == true || IsWalkable(origin) == false || IsWalkable(destination) == false)
+		return 0;
+
+	AnytimeRequest* request = new AnytimeRequest(next_anytime_id++, origin, destination, epsilon);
+	anytime_requests.push_back(request);
+	anytime->Improve(*request, anytime_first_budget_ms);
+
+	return request->id;
+}
+
+const std::vector<iPoint>* j1PathFinding::GetAnytimePath(uint id, float* bound) const
+{
+	AnytimeRequest* request = FindAnytimeRequest(id);
+
+	if (request == nullptr)
+		return nullptr;
+
+	if (bound != nullptr)
+		*bound = request->bound;
+
+	return &request->path;
+}
+
+bool j1PathFinding::IsAnytimeFinished(uint id) const
+{
+	AnytimeRequest* request = FindAnytimeRequest(id);
+	return request == nullptr || request->finished;
+}
+
+void j1PathFinding::ReleaseAnytimePath(uint id)
+{
+	std::list<AnytimeRequest*>::iterator item = anytime_requests.begin();
+
+	while (item != anytime_requests.end())
+	{
+		if ((*item)->id == id)
+		{
+			RELEASE(*item);
+			anytime_requests.erase(item);
+			anytime->Release(id);
+			break;
+		}
+		item++;
+	}
+}
+
+AnytimeRequest* j1PathFinding::FindAnytimeRequest(uint id) const
+{
+	std::list<AnytimeRequest*>::const_iterator item = anytime_requests.begin();
+
+	while (item != anytime_requests.end())
+	{
+		if ((*item)->id == id)
+			return *item;
+		item++;
+	}
+
+	return nullptr;
+}
+
+// Streamed paths ---------------------------------------------------------------------
+// The coarse route and its first segment are done here, so the unit can start
+// moving this frame. Without a quadtree (memory bounded maps) the whole path is
+// searched at once
+// ---------------------------------------------------------------------------------
+uint j1PathFinding::CreatePathStreamed(const iPoint& origin, const iPoint& destination)
+{
+	if (IsWalkable(origin) == false || IsWalkable(destination) == false)
+		return 0;
+
+	StreamRequest* request = new StreamRequest(next_stream_id++, origin, destination);
+
+	if (memory_bounded == true)
+	{
+		if (CreatePathOptimized(origin, destination) < 0)
+		{
+			RELEASE(request);
+			return 0;
+		}
+		request->path = last_path;
+		request->finished = true;
+	}
+	else if (streamer->Route(*request, *quadtree) == false)
+	{
+		RELEASE(request);
+		return 0;
+	}
+	else
+	{
+		streamer->RefineSegment(*request, *quadtree);
+	}
+
+	stream_requests.push_back(request);
+	return request->id;
+}
+
+const std::vector<iPoint>* j1PathFinding::GetStreamedPath(uint id, bool* failed) const
+{
+	StreamRequest* request = FindStreamRequest(id);
+
+	if (request == nullptr)
+		return nullptr;
+
+	if (failed != nullptr)
+		*failed = request->failed;
+
+	return &request->path;
+}
+
+bool j1PathFinding::IsStreamFinished(uint id) const
+{
+	StreamRequest* request = FindStreamRequest(id);
+	return request == nullptr || request->finished;
+}
+
+void j1PathFinding::ReleaseStreamedPath(uint id)
+{
+	std::list<StreamRequest*>::iterator item = stream_requests.begin();
+
+	while (item != stream_requests.end())
+	{
+		if ((*item)->id == id)
+		{
+			RELEASE(*item);
+			stream_requests.erase(item);
+			break;
+		}
+		item++;
+	}
+}
+
+StreamRequest* j1PathFinding::FindStreamRequest(uint id) const
+{
+	std::list<StreamRequest*>::const_iterator item = stream_requests.begin();
+
+	while (item != stream_requests.end())
+	{
+		if ((*item)->id == id)
+			return *item;
+		item++;
+	}
+
+	return nullptr;
+}
+
+void j1PathFinding::ReleaseStreamRequests()
+{
+	std::list<StreamRequest*>::iterator item = stream_requests.begin();
+	while (item != stream_requests.end())
+	{
+		RELEASE(*item);
+		item++;
+	}
+	stream_requests.clear();
+}
+
+// Memory bounded paths -------------------------------------------------------------
+// Same return value as CreatePath: ms spent, or -1 when there is no path
+// ---------------------------------------------------------------------------------
+float j1PathFinding::CreatePathIDA(const iPoint& origin, const iPoint& destination)
+{
+	j1PerfTimer timer;
+
+	if (IsWalkable(origin) == false || IsWalkable(destination) == false)
+		return -1;
+
+	last_path.clear();
+	if (bounded->FindPathIDA(origin, destination, last_path) == false)
+		return -1;
+
+	PERF_PEEK(timer);
+	return timer.ReadMs();
+}
+
+float j1PathFinding::CreatePathFringe(const iPoint& origin, const iPoint& destination)
+{
+	j1PerfTimer timer;
+
+	if (IsWalkable(origin) == false || IsWalkable(destination) == false)
+		return -1;
+
+	last_path.clear();
+	if (bounded->FindPathFringe(origin, destination, last_path) == false)
+		return -1;
+
+	PERF_PEEK(timer);
+	return timer.ReadMs();
+}
+
+bool j1PathFinding::IsMemoryBounded() const
+{
+	return memory_bounded;
+}
+
 // PathList ------------------------------------------------------------------------
 // Looks for a node in this list and returns it's list node or NULL
 // ---------------------------------------------------------------------------------
@@ -134,159 +765,22 @@ PathNode::PathNode(const PathNode& node) : g(node.g), h(node.h), pos(node.pos),
 // ----------------------------------------------------------------------------------
 uint PathNode::FindWalkableAdjacents(PathList* list_to_fill) const
 {
-	iPoint cell;
-	uint before = list_to_fill->list.size();
-
-	// north
-	cell.create(pos.x, pos.y + 1);
-	if (App->pathfinding->IsWalkable(cell))
-		list_to_fill->list.push_back(PathNode(-1, -1, cell, this));
-
-	//north east
-	cell.create(pos.x + 1, pos.y + 1);
-	if (App->pathfinding->IsWalkable(cell))
-		list_to_fill->list.push_back(PathNode(-1, -1, cell, this));
-
-	//north west
-	cell.create(pos.x - 1, pos.y + 1);
-	if (App->pathfinding->IsWalkable(cell))
-		list_to_fill->list.push_back(PathNode(-1, -1, cell, this));
-
-	// south
-	cell.create(pos.x, pos.y - 1);
-	if (App->pathfinding->IsWalkable(cell))
-		list_to_fill->list.push_back(PathNode(-1, -1, cell, this));
-
-	// south east
-	cell.create(pos.x + 1, pos.y - 1);
-	if (App->pathfinding->IsWalkable(cell))
-		list_to_fill->list.push_back(PathNode(-1, -1, cell, this));
-
-	// south west
-	cell.create(pos.x - 1, pos.y - 1);
-	if (App->pathfinding->IsWalkable(cell))
-		list_to_fill->list.push_back(PathNode(-1, -1, cell, this));
-
-	// east
-	cell.create(pos.x + 1, pos.y);
-	if (App->pathfinding->IsWalkable(cell))
-		list_to_fill->list.push_back(PathNode(-1, -1, cell, this));
-
-	// west
-	cell.create(pos.x - 1, pos.y);
-	if (App->pathfinding->IsWalkable(cell))
-		list_to_fill->list.push_back(PathNode(-1, -1, cell, this));
+	uint width, height;
+	const uchar* map = App->pathfinding->GetWalkabilityMap(width, height);
+
+	auto visit = [&](int x, int y, int cost)
+	{
+		list_to_fill->list.push_back(PathNode(-1, -1, iPoint(x, y), this));
+	};
+	GridNeighbours<DefaultSearchPolicy>::Expand(map, width, height, pos.x, pos.y, visit);
 
 	return list_to_fill->list.size();
 }
-uint PathNode::FindWalkableAdjacents(std::list<PathNode*>* list_to_fill) const
-{
-	iPoint cell;
-	uint before = list_to_fill->size();
-	bool northClose = false, southClose = false, eastClose = false, westClose = false;
-	// south
-	cell.create(pos.x, pos.y + 1);
-	if (App->pathfinding->IsWalkable(cell))
-	{
-		PathNode* node = App->pathfinding->GetPathNode(cell.x, cell.y);
-		if (node->pos != cell) {
-			node->parent = this;
-			node->pos = cell;
-		}
-		list_to_fill->push_back(node);
-	}
-	else
-	{
-		southClose = true;
-	}
-	// north
-	cell.create(pos.x, pos.y - 1);
-	if (App->pathfinding->IsWalkable(cell))
-	{
-		PathNode* node = App->pathfinding->GetPathNode(cell.x, cell.y);
-		if (node->pos != cell) {
-			node->parent = this;
-			node->pos = cell;
-		}
-		list_to_fill->push_back(node);
-	}
-	else
-	{
-		northClose = true;
-	}
-	// east
-	cell.create(pos.x + 1, pos.y);
-	if (App->pathfinding->IsWalkable(cell))
-	{
-		PathNode* node = App->pathfinding->GetPathNode(cell.x, cell.y);
-		if (node->pos != cell) {
-			node->parent = this;
-			node->pos = cell;
-		}
-		list_to_fill->push_back(node);
-	}
-	// west
-	cell.create(pos.x - 1, pos.y);
-	if (App->pathfinding->IsWalkable(cell) && cell.x != 25)
-	{
-		PathNode* node = App->pathfinding->GetPathNode(cell.x, cell.y);
-		if (node->pos != cell) {
-			node->parent = this;
-			node->pos = cell;
-		}
-		list_to_fill->push_back(node);
-	}
-	// south-east
-	cell.create(pos.x + 1, pos.y + 1);
-	if (App->pathfinding->IsWalkable(cell) && southClose == false && eastClose == false)
-	{
-		PathNode* node = App->pathfinding->GetPathNode(cell.x, cell.y);
-		if (node->pos != cell) {
-			node->parent = this;
-			node->pos = cell;
-		}
-		list_to_fill->push_back(node);
-	}
-	// south-west
-	cell.create(pos.x - 1, pos.y + 1);
-	if (App->pathfinding->IsWalkable(cell) && southClose == false && westClose == false)
-	{
-		PathNode* node = App->pathfinding->GetPathNode(cell.x, cell.y);
-		if (node->pos != cell) {
-			node->parent = this;
-			node->pos = cell;
-		}
-		list_to_fill->push_back(node);
-	}
-	// north-east
-	cell.create(pos.x + 1, pos.y - 1);
-	if (App->pathfinding->IsWalkable(cell) && northClose == false && eastClose == false)
-	{
-		PathNode* node = App->pathfinding->GetPathNode(cell.x, cell.y);
-		if (node->pos != cell) {
-			node->parent = this;
-			node->pos = cell;
-		}
-		list_to_fill->push_back(node);
-	}
-	// north-west
-	cell.create(pos.x - 1, pos.y - 1);
-	if (App->pathfinding->IsWalkable(cell) && northClose == false && westClose == false)
-	{
-		PathNode* node = App->pathfinding->GetPathNode(cell.x, cell.y);
-		if (node->pos != cell) {
-			node->parent = this;
-			node->pos = cell;
-		}
-		list_to_fill->push_back(node);
-	}
-	return list_to_fill->size();
-}
-
-// PathNode -------------------------------------------------------------------------
-// Calculates this tile score
-// ----------------------------------------------------------------------------------
-float PathNode::Score() const
+
+// PathNode -------------------------------------------------------------------------
+// Calculates this tile score
+// ----------------------------------------------------------------------------------
+float PathNode::Score() const
 {
 	return g + h;
 }
@@ -296,30 +790,8 @@ float PathNode::Score() const
 // ----------------------------------------------------------------------------------
 int PathNode::CalculateF(const iPoint& destination)
 {
-	if (parent->pos.DistanceHeuristic(pos) == 1){
-		g = parent->g + 10;
-	}
-	else if (parent->pos.DistanceHeuristic(pos) == 2) {
-		g = parent->g + 14;
-	}
-	else {
-		g = parent->g + 10;
-	}
-	h = pos.DistanceTo(destination);
-	return  g + h;
-}
-int PathNode::CalculateFopt(const iPoint& destination)
-{
-	if (parent->pos.DistanceHeuristic(pos) == 1) {
-		g = parent->g + 10;
-	}
-	else if (parent->pos.DistanceHeuristic(pos) == 2) {
-		g = parent->g + 16;
-	}
-	else {
-		g = parent->g + 10;
-	}
-	h = pos.DistanceTo(destination);
+	g = parent->g + DefaultSearchPolicy::StepCost(pos.x - parent->pos.x, pos.y - parent->pos.y);
+	h = DefaultSearchPolicy::H(pos, destination);
 	return  g + h;
 }
 
@@ -329,7 +801,7 @@ int PathNode::CalculateFopt(const iPoint& destination)
 
 float j1PathFinding::CreatePath(const iPoint& origin, const iPoint& destination)
 {
-	PERF_START(timernormal);
+	j1PerfTimer timer;
 	int ret = -1;
 	
 	if (IsWalkable(origin) && IsWalkable(destination))
@@ -340,7 +812,7 @@ float j1PathFinding::CreatePath(const iPoint& origin, const iPoint& destination)
 		close.list.clear();
 		PathList open;
 		open.list.clear();
-		open.list.push_back(PathNode(0, origin.DistanceHeuristic(destination), origin, nullptr));
+		open.list.push_back(PathNode(0, DefaultSearchPolicy::H(origin, destination), origin, nullptr));
 		while (open.list.size() != 0)
 		{
 
@@ -362,8 +834,8 @@ float j1PathFinding::CreatePath(const iPoint& origin, const iPoint& destination)
 				std::reverse(last_path.begin(), last_path.end());
 				open.list.clear();
 				close.list.clear();
-				PERF_PEEK(timernormal);
-				return timernormal.ReadMs();
+				PERF_PEEK(timer);
+				return timer.ReadMs();
 				
 			}
 			else
@@ -412,94 +884,580 @@ bool PathNode::operator!=(const PathNode & node) const
 
 float j1PathFinding::CreatePathOptimized(const iPoint & origin, const iPoint & destination)
 {
-	PERF_START(timernormal);
-	int size = width*height;
-	//TODO 2
-	// Fill the node_map with with null PathNodes 
-	std::fill(node_map, node_map + size, PathNode(-1, -1, iPoint(-1, -1), nullptr));
-	int ret = -1;
+	// no node map on huge maps: fringe search, and IDA* if its table fills up
+	if (IsMemoryBounded() == true)
+	{
+		float ret = CreatePathFringe(origin, destination);
+		return (ret < 0 && bounded->FringeOverflowed() == true) ? CreatePathIDA(origin, destination) : ret;
+	}
 
-	if (IsWalkable(origin) && IsWalkable(destination))
+	j1PerfTimer timer;
+
+	if (FindPathLanes(GetSearchContext(), origin, destination, last_path) == false)
+		return -1;
+
+	PERF_PEEK(timer);
+	return timer.ReadMs();
+}
+
+float j1PathFinding::CreatePathRSR(const iPoint& origin, const iPoint& destination)
+{
+	j1PerfTimer timer;
+
+	if (symmetry->FindPath(GetSearchContext(), origin, destination, last_path) == false)
+		return -1;
+
+	PERF_PEEK(timer);
+	return timer.ReadMs();
+}
+
+float j1PathFinding::CreatePathDatabase(const iPoint& origin, const iPoint& destination)
+{
+	j1PerfTimer timer;
+
+	if (database->FindPath(origin, destination, last_path) == false)
+		return -1;
+
+	PERF_PEEK(timer);
+	return timer.ReadMs();
+}
+
+float j1PathFinding::CreatePathRooms(const iPoint& origin, const iPoint& destination)
+{
+	j1PerfTimer timer;
+
+	if (rooms->FindPath(GetSearchContext(), origin, destination, last_path) == false &&
+		CreatePathOptimized(origin, destination) < 0)
+		return -1;
+
+	PERF_PEEK(timer);
+	return timer.ReadMs();
+}
+
+float j1PathFinding::CreatePathNavMesh(const iPoint& origin, const iPoint& destination)
+{
+	j1PerfTimer timer;
+
+	if (navmesh->FindPath(origin, destination, last_path) == false)
+		return -1;
+
+	PERF_PEEK(timer);
+	return timer.ReadMs();
+}
+
+float j1PathFinding::CreatePathVisibility(const iPoint& origin, const iPoint& destination)
+{
+	j1PerfTimer timer;
+
+	if (visibility->FindPath(origin, destination, last_path) == false)
+		return -1;
+
+	PERF_PEEK(timer);
+	return timer.ReadMs();
+}
+
+float j1PathFinding::CreatePathQuadTree(const iPoint& origin, const iPoint& destination)
+{
+	j1PerfTimer timer;
+
+	if (quadtree->FindPath(origin, destination, last_path) == false)
+		return -1;
+
+	PERF_PEEK(timer);
+	return timer.ReadMs();
+}
+
+float j1PathFinding::CreatePathAdaptive(const iPoint& origin, const iPoint& destination)
+{
+	j1PerfTimer timer;
+
+	if (adaptive->FindPath(GetSearchContext(), origin, destination, last_path) == false)
+		return -1;
+
+	PERF_PEEK(timer);
+	return timer.ReadMs();
+}
+
+float j1PathFinding::CreatePathParallel(const iPoint& origin, const iPoint& destination)
+{
+	j1PerfTimer timer;
+
+	if (parallel->FindPath(origin, destination, last_path) == false)
+		return -1;
+
+	PERF_PEEK(timer);
+	return timer.ReadMs();
+}
+
+float j1PathFinding::CreatePathNearest(const iPoint& origin, const iPoint& destination)
+{
+	j1PerfTimer timer;
+	iPoint target;
+
+	for (uint attempt = 0; attempt < 2; ++attempt)
 	{
-		ret = 1;
-		//TODO 3 
-		//Create a priority_queue open that compares a PathNode* in a vector of PathNodes* using the compare struct
-		std::priority_queue<PathNode*, std::vector<PathNode*>, compare> open;
-		//TODO 5
-		//Inicialize firstNode getting its node and setting its position, g and h
-		PathNode* firstNode = GetPathNode(origin.x, origin.y);
-		firstNode->SetPosition(origin);
-		firstNode->g = 0;
-		firstNode->h = origin.DistanceTo(destination);
-
-		open.push(firstNode);
-		PathNode* current = nullptr;
-		while (open.size() != 0)
+		if (FindNearestReachable(origin, destination, target) == false)
+			return -1;
+
+		if (CreatePathOptimized(origin, target) >= 0)
 		{
-			//TODO 6 
-			//Get the top of the queue as the current node, set it on_close and pop the top node.
-			current = open.top();
-			open.top()->on_close = true;
-			open.pop();
-			if (current->pos == destination)
-			{
+			PERF_PEEK(timer);
+			return timer.ReadMs();
+		}
 
-				std::vector<iPoint>* path = new std::vector<iPoint>;
-				last_path.clear();
-				//TODO 8
-				// make a look for current, and until its parent is nullptr, make current = ParentNode
-				for (; current->parent != nullptr; current = GetPathNode(current->parent->pos.x, current->parent->pos.y))
-				{
-					last_path.push_back(current->pos);
-				}
-				last_path.push_back(current->pos);
-				PERF_PEEK(timernormal);
-				return timernormal.ReadMs();
-			}
-			else
-			{
-				std::list<PathNode*> neighbours;
-				current->FindWalkableAdjacents(&neighbours);
-				for (std::list<PathNode*>::iterator item = neighbours.begin(); item != neighbours.end(); item++) {
-					PathNode* temp = item._Mynode()->_Myval;
-					//TODO 7
-					//change if an else if for on_open, on_close booleans 
-					if (temp->on_close == true)
-					{
-						continue;
-					}
-					else if (temp->on_open == true)
-					{
-						int last_g_value = temp->g;
-						temp->CalculateFopt(destination);
-						if (last_g_value < temp->g)
-						{
-							temp->parent = GetPathNode(current->pos.x, current->pos.y);
-						}
-						else {
-							temp->g = last_g_value;
-						}
-					}
-					else
-					{
-						temp->on_open = true;
-						temp->CalculateFopt(destination);
-						open.push(temp);
-					}
-				}
+		// bounded labels are already current, the selector ones can be stale after a
+		// closed tile split the component: the next Connected relabels it and the
+		// retry picks a tile the origin reaches
+		if (memory_bounded == true)
+			break;
+		selector->Disconnected();
+	}
+
+	return -1;
+}
+
+// ----------------------------------------------------------------------------------
+// Square rings around the target from the inside out, every tile is checked against
+// the component labels of the selector instead of being searched for. A tile of
+// ring r is at least r straight steps away, so rings stop once that is no closer
+// than the best tile found. Memory bounded maps use the labels of the bounded
+// searches, which are redone as soon as a tile change may split a component
+// ----------------------------------------------------------------------------------
+bool j1PathFinding::FindNearestReachable(const iPoint& origin, const iPoint& target, iPoint& nearest)
+{
+	if (IsWalkable(origin) == false)
+		return false;
+
+	int best = -1;
+	auto test = [&](int x, int y)
+	{
+		iPoint pos(x, y);
+		if (IsWalkable(pos) == false)
+			return;
+
+		int distance = DefaultSearchPolicy::H(pos, target);
+		if (best >= 0 && distance >= best)
+			return;
+
+		bool connected = (memory_bounded == true) ? bounded->Connected(origin, pos) : selector->Connected(origin, pos, map);
+		if (connected == true)
+		{
+			best = distance;
+			nearest = pos;
+		}
+	};
+
+	int max_radius = MAX(MAX(abs(target.x), abs((int)width - 1 - target.x)), MAX(abs(target.y), abs((int)height - 1 - target.y)));
+	test(target.x, target.y);
+
+	for (int r = 1; r <= max_radius && (best < 0 || r * DefaultSearchPolicy::Cost::STRAIGHT < best); ++r)
+	{
+		for (int i = -r; i <= r; ++i)
+		{
+			test(target.x + i, target.y - r);
+			test(target.x + i, target.y + r);
+		}
+		for (int i = -r + 1; i < r; ++i)
+		{
+			test(target.x - r, target.y + i);
+			test(target.x + r, target.y + i);
+		}
+	}
+
+	return best >= 0;
+}
+
+// ----------------------------------------------------------------------------------
+// The selector only picks among engines with valid data: the database until a tile
+// changes, the symmetry reduction and lanes while there is a node map
+// ----------------------------------------------------------------------------------
+float j1PathFinding::CreatePathAuto(const iPoint& origin, const iPoint& destination)
+{
+	if (memory_bounded == true)
+		return CreatePathOptimized(origin, destination);
+
+	j1PerfTimer timer;
+
+	if (IsWalkable(origin) == false || IsWalkable(destination) == false ||
+		selector->Connected(origin, destination, map) == false)
+		return -1;
+
+	bool available[PATH_ENGINE_COUNT] = { database->IsLoaded(), true, true };
+	uint bucket = selector->Bucket(origin, destination);
+	PathEngine engine = selector->Choose(bucket, available);
+
+	float ms;
+	switch (engine)
+	{
+	case PATH_ENGINE_DATABASE: ms = CreatePathDatabase(origin, destination); break;
+	case PATH_ENGINE_RSR: ms = CreatePathRSR(origin, destination); break;
+	default: ms = CreatePathOptimized(origin, destination); break;
+	}
+
+	if (ms < 0)
+	{
+		// a closed tile split the component after it was labelled
+		selector->Disconnected();
+		return -1;
+	}
 
-				neighbours.clear();
+	selector->Record(bucket, engine, ms);
+
+	PERF_PEEK(timer);
+	return timer.ReadMs();
+}
+
+// ----------------------------------------------------------------------------------
+// A* over struct of arrays nodes: each expansion runs the kernel picked in Awake
+// and only walks the lanes it reports as improved
+// ----------------------------------------------------------------------------------
+bool j1PathFinding::FindPathLanes(SearchContext& context, const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const
+{
+	if (memory_bounded == true || IsWalkable(origin) == false || IsWalkable(destination) == false)
+		return false;
+
+	int row = width + 2;
+	LaneNodes& nodes = context.BeginLanes(row * (height + 2));
+	int goal = (destination.y + 1) * row + destination.x + 1;
+
+	ExpandLanes lanes;
+	lanes.walk = lane_map.data();
+	lanes.nodes = &nodes;
+	lanes.offsets = lane_offsets;
+	lanes.destination = destination;
+	bool pruning = goal_bounds->IsLoaded();
+	uint origin_region = dead_ends->GetRegion(origin);
+	uint destination_region = dead_ends->GetRegion(destination);
+
+	int first = (origin.y + 1) * row + origin.x + 1;
+	nodes.g[first] = 0;
+	nodes.parent[first] = -1;
+	nodes.state[first] = nodes.open_state;
+	nodes.PushOpen(first, DefaultSearchPolicy::H(origin, destination));
+
+	int current;
+	while ((current = nodes.PopOpen()) >= 0)
+	{
+		if (nodes.state[current] == nodes.closed_state)
+			continue;
+		nodes.state[current] = nodes.closed_state;
+
+		if (current == goal)
+		{
+			path_to_fill.clear();
+			for (int index = current; index >= 0; index = nodes.parent[index])
+				path_to_fill.push_back(iPoint(index % row - 1, index / row - 1));
+			std::reverse(path_to_fill.begin(), path_to_fill.end());
+			return true;
+		}
+
+		lanes.index = current;
+		lanes.pos.create(current % row - 1, current / row - 1);
+		lanes.g = nodes.g[current];
+
+		uint improved = expand_kernel(lanes);
+		if (pruning == true)
+			improved &= goal_bounds->Directions(lanes.pos, destination);
+
+		for (uint dir = 0; improved != 0; ++dir, improved >>= 1)
+		{
+			if ((improved & 1) == 0 ||
+				dead_ends->Skip(lanes.pos.x + grid_dirs[dir][0], lanes.pos.y + grid_dirs[dir][1], origin_region, destination_region) == true)
+				continue;
+
+			int index = current + lane_offsets[dir];
+			nodes.g[index] = lanes.new_g[dir];
+			nodes.parent[index] = current;
+			nodes.state[index] = nodes.open_state;
+			nodes.PushOpen(index, lanes.new_g[dir] + lanes.h[dir]);
+		}
+	}
+
+	return false;
+}
+
+// ----------------------------------------------------------------------------------
+// Cost bounded multi source Dijkstra on the lanes of the calling thread context.
+// Lane state is reset by generation, so the work only depends on the tiles reached
+// ----------------------------------------------------------------------------------
+uint j1PathFinding::FloodRange(const iPoint* sources, uint count, int max_cost, uint64* mask, int* distances, std::vector<iPoint>* reached)
+{
+	if (memory_bounded == true || max_cost < 0)
+		return 0;
+
+	int row = width + 2;
+	LaneNodes& nodes = GetSearchContext().BeginLanes(row * (height + 2));
+	uint ret = 0;
+
+	ExpandLanes lanes;
+	lanes.walk = lane_map.data();
+	lanes.nodes = &nodes;
+	lanes.offsets = lane_offsets;
+
+	for (uint i = 0; i < count; ++i)
+	{
+		if (IsWalkable(sources[i]) == false)
+			continue;
+
+		int index = (sources[i].y + 1) * row + sources[i].x + 1;
+		nodes.g[index] = 0;
+		nodes.state[index] = nodes.open_state;
+		nodes.PushOpen(index, 0);
+	}
+
+	int current;
+	while ((current = nodes.PopOpen()) >= 0)
+	{
+		if (nodes.state[current] == nodes.closed_state)
+			continue;
+		nodes.state[current] = nodes.closed_state;
+
+		int x = current % row - 1, y = current / row - 1;
+		uint tile = (y * width) + x;
+		if (mask != nullptr)
+			mask[tile >> 6] |= (uint64)1 << (tile & 63);
+		if (distances != nullptr)
+			distances[tile] = nodes.g[current];
+		if (reached != nullptr)
+			reached->push_back(iPoint(x, y));
+		ret++;
+
+		// there is no goal, h is left out of the scores
+		lanes.index = current;
+		lanes.pos.create(x, y);
+		lanes.destination = lanes.pos;
+		lanes.g = nodes.g[current];
+
+		uint improved = expand_kernel(lanes);
+		for (uint dir = 0; improved != 0; ++dir, improved >>= 1)
+		{
+			if ((improved & 1) == 0 || lanes.new_g[dir] > max_cost)
+				continue;
+
+			int index = current + lane_offsets[dir];
+			nodes.g[index] = lanes.new_g[dir];
+			nodes.state[index] = nodes.open_state;
+			nodes.PushOpen(index, lanes.new_g[dir]);
+		}
+	}
+
+	return ret;
+}
+
+// ----------------------------------------------------------------------------------
+// Bit-parallel breadth first search: a tile keeps the sources that reached it in
+// a word and each layer only pushes the bits that are new to every neighbour,
+// so the 64 searches advance together in a single sweep. The visited words live
+// in the context and are reset as they are reached, the frontier bits travel in
+// the layer lists with their tile
+// ----------------------------------------------------------------------------------
+bool j1PathFinding::MultiSourceLayers(const iPoint* sources, uint count, const iPoint* targets, uint target_count, int* layers, uint64* reachable)
+{
+	if (count > MAX_LAYER_SOURCES || map == NULL || memory_bounded == true)
+		return false;
+
+	std::fill(layers, layers + target_count * count, -1);
+
+	SearchContext& context = GetSearchContext();
+	context.BeginLayers(width, height);
+
+	struct LayerEntry
+	{
+		uint tile;
+		uint64 bits;
+	};
+	std::vector<LayerEntry> current, next;
+
+	// a tile is only once in a layer list, its slot finds it to add more bits
+	auto push = [&](std::vector<LayerEntry>& list, uint tile, uint64 bits)
+	{
+		LayerTile& state = context.GetLayerTile(tile);
+		state.visited |= bits;
+
+		if (state.slot < list.size() && list[state.slot].tile == tile)
+		{
+			list[state.slot].bits |= bits;
+			return;
+		}
+
+		state.slot = list.size();
+		LayerEntry entry = { tile, bits };
+		list.push_back(entry);
+	};
+
+	for (uint i = 0; i < count; ++i)
+	{
+		if (IsWalkable(sources[i]) == false)
+			continue;
+
+		push(current, (sources[i].y * width) + sources[i].x, (uint64)1 << i);
+	}
+
+	// sources already written for every target
+	std::vector<uint64> found(target_count, 0);
+
+	for (int layer = 0; current.size() != 0; ++layer)
+	{
+		for (uint t = 0; t < target_count; ++t)
+		{
+			if (CheckBoundaries(targets[t]) == false)
+				continue;
+
+			uint tile = (targets[t].y * width) + targets[t].x;
+			if (context.HasLayerTile(tile) == false)
+				continue;
+
+			uint64 bits = context.GetLayerTile(tile).visited & ~found[t];
+			found[t] |= bits;
+			for (uint s = 0; bits != 0; ++s, bits >>= 1)
+			{
+				if (bits & 1)
+					layers[t * count + s] = layer;
 			}
 		}
+
+		next.clear();
+		for (std::vector<LayerEntry>::const_iterator item = current.begin(); item != current.end(); ++item)
+		{
+			uint64 bits = item->bits;
+
+			auto visit = [&](int x, int y, int)
+			{
+				uint tile = (y * width) + x;
+				uint64 fresh = bits & ~context.GetLayerTile(tile).visited;
+				if (fresh != 0)
+					push(next, tile, fresh);
+			};
+			GridNeighbours<DefaultSearchPolicy>::Expand(map, width, height, item->tile % width, item->tile / width, visit);
+		}
+		current.swap(next);
 	}
-	return -1;
+
+	if (reachable != nullptr)
+	{
+		for (uint tile = 0; tile < width*height; ++tile)
+			reachable[tile] = context.HasLayerTile(tile) ? context.GetLayerTile(tile).visited : 0;
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------
+// Line of sight
+// ----------------------------------------------------------------------------------
+bool j1PathFinding::LineOfSight(const iPoint& from, const iPoint& to) const
+{
+	return sight->Clear(from, to);
+}
+
+// Threads get whole 64 query words so no result word is shared between them
+void j1PathFinding::LineOfSightBatch(const SightQuery* queries, uint count, uint64* results, uint threads) const
+{
+	if (threads == 0)
+		threads = SDL_GetCPUCount();
+
+	sight_workers->Run(*sight, queries, count, results, threads);
 }
 
 //TODO 4
 // Create a function that returns a pointer of a PathNode by entering its position.
 PathNode* j1PathFinding::GetPathNode(int x, int y)
 {
-	return &node_map[(y*width) + x];
+	return GetSearchContext().GetNode(x, y);
+}
+
+SearchContext& j1PathFinding::GetSearchContext()
+{
+	return contexts.ForThisThread();
+}
+
+// SearchContext ---------------------------------------------------------------------
+// ---------------------------------------------------------------------------------
+SearchContext::SearchContext() : width(0), height(0), stamp(0)
+{}
+
+void SearchContext::Begin(uint width, uint height)
+{
+	if (nodes.size() < width*height)
+	{
+		nodes.resize(width*height);
+		stamps.resize(width*height, 0);
+	}
+
+	// a stamp wrap around would make very old nodes look current
+	if (++stamp == 0)
+	{
+		std::fill(stamps.begin(), stamps.end(), 0);
+		stamp = 1;
+	}
+
+	this->width = width;
+	this->height = height;
+	open.clear();
+}
+
+void SearchContext::BeginLayers(uint width, uint height)
+{
+	if (layer_tiles.size() < width*height)
+	{
+		layer_tiles.resize(width*height);
+		layer_stamps.resize(width*height, 0);
+	}
+
+	if (++layer_stamp == 0)
+	{
+		std::fill(layer_stamps.begin(), layer_stamps.end(), 0);
+		layer_stamp = 1;
+	}
+}
+
+LaneNodes& SearchContext::BeginLanes(uint padded_tiles)
+{
+	lanes.Begin(padded_tiles);
+	return lanes;
+}
+
+// SearchContextPool -----------------------------------------------------------------
+// ---------------------------------------------------------------------------------
+SearchContextPool::SearchContextPool() : epoch(1)
+{}
+
+// Destructor
+SearchContextPool::~SearchContextPool()
+{
+	Clear();
+}
+
+SearchContext& SearchContextPool::ForThisThread()
+{
+	struct ThreadSlot
+	{
+		const SearchContextPool* pool;
+		uint epoch;
+		SearchContext* context;
+	};
+	static thread_local ThreadSlot slot = { nullptr, 0, nullptr };
+
+	if (slot.pool != this || slot.epoch != epoch)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		slot.context = new SearchContext();
+		slot.pool = this;
+		slot.epoch = epoch;
+		contexts.push_back(slot.context);
+	}
+
+	return *slot.context;
+}
+
+void SearchContextPool::Clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (std::vector<SearchContext*>::iterator item = contexts.begin(); item != contexts.end(); ++item)
+		RELEASE(*item);
+	contexts.clear();
+	epoch++;
 }
 
 void PathNode::SetPosition(const iPoint & value)
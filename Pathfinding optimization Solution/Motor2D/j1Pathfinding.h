@@ -5,12 +5,30 @@
 #include "p2Point.h"
 #include "p2DynArray.h"
 #include "j1PerfTimer.h"
+#include "SDL\include\SDL_rect.h"
 #include <vector>
 #include <queue>
 #include <list>
+#include <string>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
 
 #define DEFAULT_PATH_LENGTH 0
-#define INVALID_WALK_CODE 255
+#define DEFAULT_ANYTIME_EPSILON 3.0f
+#define DEFAULT_ANYTIME_BUDGET_MS 0.5f
+#define DEFAULT_ANYTIME_FIRST_BUDGET_MS 0.05f
+// maps with more tiles than this get no node map and use the memory bounded searches
+#define DEFAULT_MAX_NODE_MAP_TILES 4194304
+// one bit per source in the multi source breadth first search
+#define MAX_LAYER_SOURCES 64
+// more obstacle corners than this and no visibility graph is built
+#define DEFAULT_VISIBILITY_MAX_CORNERS 1024
+
+#include "PathPolicies.h"
+#include "PathSimd.h"
+#include "PathArena.h"
+#include "PathStream.h"
 
 // --------------------------------------------------
 // Recommended reading:
@@ -18,6 +36,56 @@
 // Details: http://theory.stanford.edu/~amitp/GameProgramming/
 // --------------------------------------------------
 struct PathNode;
+struct AnytimeRequest;
+struct StreamRequest;
+class PathStreamer;
+class AnytimeSearch;
+class AdaptiveSearch;
+class ParallelSearch;
+class BoundedSearch;
+class SearchContext;
+class SightMap;
+class SightWorkers;
+class SymmetryReduction;
+class PathDatabase;
+class GoalBounds;
+class DeadEnds;
+class RoomGraph;
+class NavMesh;
+class VisibilityGraph;
+class QuadTree;
+class GroupPlanner;
+struct GroupStats;
+class CompactPath;
+class PathSelector;
+struct SightQuery;
+
+// ---------------------------------------------------------------------
+// SearchContextPool: hands every thread that searches its own context,
+// contexts are kept and reused until the pool is cleared
+// ---------------------------------------------------------------------
+class SearchContextPool
+{
+public:
+
+	SearchContextPool();
+
+	// Destructor
+	~SearchContextPool();
+
+	// Context owned by the calling thread, created on its first search
+	SearchContext& ForThisThread();
+
+	// Frees every context, threads get a new one on their next search
+	void Clear();
+
+private:
+
+	std::mutex mutex;
+	std::vector<SearchContext*> contexts;
+	std::atomic<uint> epoch;
+};
+
 class j1PathFinding : public j1Module
 {
 public:
@@ -27,19 +95,163 @@ public:
 	// Destructor
 	~j1PathFinding();
 
+	// Called before render is available
+	bool Awake(pugi::xml_node& config);
+
+	// Called each loop iteration
+	bool Update(float dt);
+
 	// Called before quitting
 	bool CleanUp();
 
 	// Sets up the walkability map
 	void SetMap(uint width, uint height, uchar* data);
 
+	// Changes a single tile, everything built from the map is updated around it
+	void SetTileAt(const iPoint& pos, uchar value);
+
+	// Designer rooms and portals in tiles for the current map, see PathRooms.h
+	void SetRooms(const std::vector<SDL_Rect>& rooms, const std::vector<SDL_Rect>& portals);
+
 	// Main function to request a path from A to B
 	float CreatePath(const iPoint& origin, const iPoint& destination);
 
 	float CreatePathOptimized(const iPoint & origin, const iPoint & destination);
+
+	// Node map A* compiled for a rule set, see PathPolicies.h
+	template<class Policy>
+	float CreatePathWith(const iPoint& origin, const iPoint& destination);
+
+	// Reentrant A* compiled for a rule set and the hooks of its caller, see PathPolicies.h.
+	// All scratch memory comes from the context, the path goes to path_to_fill
+	template<class Policy, class Hooks>
+	bool FindPath(SearchContext& context, const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill, Hooks& hooks) const;
+
+	// Rectangular symmetry reduction A*, only rectangle perimeters are expanded
+	float CreatePathRSR(const iPoint& origin, const iPoint& destination);
+
+	// Path from the compressed path database set in the config, see PathDatabase.h
+	float CreatePathDatabase(const iPoint& origin, const iPoint& destination);
+
+	// Tile search over the rooms of the cheapest room route, endpoints outside
+	// the rooms or a route the tiles can't follow fall back to CreatePathOptimized
+	float CreatePathRooms(const iPoint& origin, const iPoint& destination);
+
+	// Navmesh path, last_path gets the waypoints with walkable straight lines between them
+	float CreatePathNavMesh(const iPoint& origin, const iPoint& destination);
+
+	// Any-angle path over the visibility graph of obstacle corners, last_path gets the
+	// waypoints. Fails on maps with more corners than the config allows
+	float CreatePathVisibility(const iPoint& origin, const iPoint& destination);
+
+	// A* over the walkable leaves of the quadtree, see PathQuadTree.h
+	float CreatePathQuadTree(const iPoint& origin, const iPoint& destination);
+
+	// A* that learns a better heuristic for each goal from the searches made toward it,
+	// see PathAdaptive.h. Repeated queries to a goal expand fewer tiles every time
+	float CreatePathAdaptive(const iPoint& origin, const iPoint& destination);
+
+	// A* split across threads by hashing tiles to them, see PathParallel.h. Only
+	// pays off on long queries over big maps, threads come from the config
+	float CreatePathParallel(const iPoint& origin, const iPoint& destination);
+
+	// Path to the destination, or to the closest walkable tile the origin can reach
+	// when the destination is blocked or cut off from it
+	float CreatePathNearest(const iPoint& origin, const iPoint& destination);
+
+	// Closest walkable tile to target (octile distance) in the component of origin
+	bool FindNearestReachable(const iPoint& origin, const iPoint& target, iPoint& nearest);
+
+	// Optimal path from whichever engine has been fastest on similar queries, see
+	// PathSelector.h. Endpoints in different components fail without a search
+	float CreatePathAuto(const iPoint& origin, const iPoint& destination);
+
+	// Reentrant A* with the default rules, neighbours are expanded by the vector kernel
+	// and pruned by the goal bounds when the config enables them. Dead-end regions
+	// are skipped unless an endpoint is inside
+	bool FindPathLanes(SearchContext& context, const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill) const;
+
+	// Scratch memory of the calling thread
+	SearchContext& GetSearchContext();
+
+	// Anytime (ARA*) path: returns a request id (0 on failure), the path is refined every frame
+	uint CreatePathAnytime(const iPoint& origin, const iPoint& destination, float epsilon = DEFAULT_ANYTIME_EPSILON);
+
+	// Best path found so far for an anytime request and its sub-optimality bound
+	const std::vector<iPoint>* GetAnytimePath(uint id, float* bound = nullptr) const;
+
+	// True once the anytime request has reached its optimal path or failed
+	bool IsAnytimeFinished(uint id) const;
+
+	// Stops refining and forgets an anytime request
+	void ReleaseAnytimePath(uint id);
+
+	// Streamed path: returns a request id (0 on failure). The first tiles are published
+	// before it returns and the rest stream in every frame, see PathStream.h
+	uint CreatePathStreamed(const iPoint& origin, const iPoint& destination);
+
+	// Tiles published so far for a streamed request, they stay as they are while
+	// more are appended. failed is set when the destination turned out unreachable
+	const std::vector<iPoint>* GetStreamedPath(uint id, bool* failed = nullptr) const;
+
+	// True once the streamed path reaches the destination or failed
+	bool IsStreamFinished(uint id) const;
+
+	// Stops streaming and forgets a streamed request
+	void ReleaseStreamedPath(uint id);
+
+	// Memory bounded searches, they only need O(path) plus a fixed size table
+	float CreatePathIDA(const iPoint& origin, const iPoint& destination);
+	float CreatePathFringe(const iPoint& origin, const iPoint& destination);
+
+	// True when the map was too big for a node map and only bounded searches are available
+	bool IsMemoryBounded() const;
+
+	// Tiles reachable from any of the sources within max_cost (10 straight, 14 diagonal).
+	// Only reached tiles are written: their bit in mask (bit y * width + x) and their cost in
+	// distances, both width * height long and optional. Returns how many tiles were reached
+	uint FloodRange(const iPoint* sources, uint count, int max_cost, uint64* mask, int* distances = nullptr, std::vector<iPoint>* reached = nullptr);
+
+	// Breadth first search from up to 64 sources at once, one bit per source on every tile.
+	// layers[t * count + s] gets the steps from source s to target t, -1 if unreachable.
+	// reachable (optional, width * height words) gets the sources that reach each tile.
+	// Fails on memory bounded maps
+	bool MultiSourceLayers(const iPoint* sources, uint count, const iPoint* targets, uint target_count, int* layers, uint64* reachable = nullptr);
+
+	// True when nothing unwalkable lies on the straight line between both tiles
+	bool LineOfSight(const iPoint& from, const iPoint& to) const;
+
+	// Evaluates count queries into results, bit i of word i / 64 is set when query i
+	// is clear. results needs (count + 63) / 64 words, threads 0 uses every cpu
+	void LineOfSightBatch(const SightQuery* queries, uint count, uint64* results, uint threads = 1) const;
+
 	// To request all tiles involved in the last generated path
 	const std::vector<iPoint>* GetLastPath() const;
 
+	// Same search as CreatePathOptimized into a result of its own, see PathArena.h.
+	// PATH_HANDLE_NONE when there is no path
+	PathHandle RequestPath(const iPoint& origin, const iPoint& destination);
+
+	// Tiles of a result without copying them, empty once it is released
+	PathSpan GetPath(PathHandle handle) const;
+
+	// Gives the result storage back to the arena
+	void ReleasePath(PathHandle handle);
+
+	// Move order for a group: handles[i] gets the path of units[i] to its formation slot
+	// around the destination, PATH_HANDLE_NONE for units that can't get there. One leader
+	// search plus small corrections, see PathGroup.h. False if the leader has no path
+	bool RequestGroupPath(const std::vector<iPoint>& units, const iPoint& destination, std::vector<PathHandle>& handles, GroupStats* stats = nullptr);
+
+	// Last path as start tile and direction runs, see PathCompact.h. False if it
+	// was post-processed into waypoints that aren't neighbours
+	bool GetLastPathCompact(CompactPath& path) const;
+
+	// Cuts a path down to its waypoints in place, steps is a mask of PathPostProcess
+	// (see PathSmooth.h) applied collinear removal first
+	void PostProcess(std::vector<iPoint>& path, uint steps) const;
+	void PostProcessLastPath(uint steps);
+
 	// Utility: return true if pos is inside the map boundaries
 	bool CheckBoundaries(const iPoint& pos) const;
 
@@ -49,19 +261,82 @@ public:
 	// Utility: return the walkability value of a tile
 	uchar GetTileAt(const iPoint& pos) const;
 
+	// Utility: raw walkability map for the search kernels
+	const uchar* GetWalkabilityMap(uint& width, uint& height) const;
+
+	// Node of the last search made by the calling thread
 	PathNode* GetPathNode(int x, int y);
 private:
-	j1PerfTimer timernormal;
-	j1PerfTimer timeopt;
+	AnytimeRequest* FindAnytimeRequest(uint id) const;
+	StreamRequest* FindStreamRequest(uint id) const;
+	void ReleaseStreamRequests();
+
 	// size of the map
 	uint width;
 	uint height;
 	// all map walkability values [0..255]
 	uchar* map;
 	//TODO1 create a node map
-	PathNode* node_map;
+	// every searching thread keeps its node map in its own context
+	SearchContextPool contexts;
 	// we store the created path here
 	std::vector<iPoint> last_path;
+	// results handed out by RequestPath
+	PathArena* paths;
+	// anytime requests being refined, front first
+	AnytimeSearch* anytime;
+	std::list<AnytimeRequest*> anytime_requests;
+	uint next_anytime_id = 1;
+	// time spent refining anytime paths each frame and when they are created
+	float anytime_budget_ms = DEFAULT_ANYTIME_BUDGET_MS;
+	float anytime_first_budget_ms = DEFAULT_ANYTIME_FIRST_BUDGET_MS;
+	// heuristics learned toward the latest goals
+	AdaptiveSearch* adaptive;
+	// hash distributed A* threads and their per tile state
+	ParallelSearch* parallel;
+	// streamed requests being refined, front first, and the time they get each frame
+	PathStreamer* streamer;
+	std::list<StreamRequest*> stream_requests;
+	uint next_stream_id = 1;
+	float stream_budget_ms = DEFAULT_STREAM_BUDGET_MS;
+	// formation planner and the leader path of the last group order, with the
+	// result storage of its units
+	GroupPlanner* group;
+	std::vector<iPoint> group_leader;
+	std::vector<std::vector<iPoint>*> group_paths;
+	// memory bounded searches and the limit that enables them
+	BoundedSearch* bounded;
+	uint max_node_map_tiles = DEFAULT_MAX_NODE_MAP_TILES;
+	bool memory_bounded = false;
+	// bit-packed walkability for line of sight queries
+	SightMap* sight;
+	// threads kept for big line of sight batches
+	SightWorkers* sight_workers;
+	// corners of sparse maps and the lines of sight between them
+	VisibilityGraph* visibility;
+	uint visibility_max_corners = DEFAULT_VISIBILITY_MAX_CORNERS;
+	// empty rectangles for the symmetry reduction searches
+	SymmetryReduction* symmetry;
+	// convex polygons of walkable tiles, see PathNavMesh.h
+	NavMesh* navmesh;
+	// uniform squares of the map and the links between them
+	QuadTree* quadtree;
+	// engine statistics and component labels for CreatePathAuto
+	PathSelector* selector;
+	// regions behind a single tile, no path between two tiles outside crosses them
+	DeadEnds* dead_ends;
+	// rooms and portals from the map objects
+	RoomGraph* rooms;
+	// first-move tables built offline for this map, mapped at SetMap
+	PathDatabase* database;
+	std::string database_file;
+	// per direction boxes of the targets reached through it, cached at SetMap
+	GoalBounds* goal_bounds;
+	std::string goal_bounds_file;
+	// walkability with an unwalkable border for the expansion kernel, see PathSimd.h
+	std::vector<uchar> lane_map;
+	int lane_offsets[LANE_NEIGHBOURS];
+	ExpandKernel expand_kernel = ExpandScalar;
 };
 
 // forward declaration
@@ -80,12 +355,10 @@ struct PathNode
 	// Fills a list (PathList) of all valid adjacent pathnodes
 	uint FindWalkableAdjacents(PathList* list_to_fill) const;
 
-	uint FindWalkableAdjacents(std::list<PathNode*>* list_to_fill) const;
 	// Calculates this tile score
 	float Score() const;
 	// Calculate the F for a specific destination tile
 	int CalculateF(const iPoint& destination);
-	int CalculateFopt(const iPoint& destination);
 	void SetPosition(const iPoint & value);
 	// -----------
 	float g;
@@ -128,11 +401,225 @@ struct PathListOptimized
 	// The list itself
 	std::list<PathNode*> list;
 };
+
+// ---------------------------------------------------------------------
+// Open list entry: the score is copied when the node is pushed, a node that
+// improves is pushed again and its old entries are skipped once it is closed
+// ---------------------------------------------------------------------
+struct OpenNode
+{
+	OpenNode(PathNode* node) : score(node->Score()), node(node)
+	{}
+
+	float score;
+	PathNode* node;
+};
+
 struct compare
 {
-	bool operator()(const PathNode* l, const PathNode* r)
+	bool operator()(const OpenNode& l, const OpenNode& r) const
 	{
-		return l->Score() >= r->Score();
+		return l.score > r.score;
 	}
 };
+
+// ---------------------------------------------------------------------
+// Tile state of MultiSourceLayers: sources that reached it and where it
+// is in the list of the next layer
+// ---------------------------------------------------------------------
+struct LayerTile
+{
+	uint64 visited;
+	uint slot;
+};
+
+// ---------------------------------------------------------------------
+// SearchContext: scratch memory of one search at a time (node states and
+// open list). Buffers only grow, nodes left by an earlier search are reset
+// the first time the next one touches them, so a warm context allocates nothing
+// ---------------------------------------------------------------------
+class SearchContext
+{
+public:
+
+	SearchContext();
+
+	// Starts a new search over a map of this size
+	void Begin(uint width, uint height);
+
+	// Node of a tile for the current search
+	PathNode* GetNode(int x, int y);
+
+	// Open list as a binary heap over a reused vector
+	void PushOpen(PathNode* node);
+	PathNode* PopOpen();
+
+	// Struct of arrays node state used by FindPathLanes
+	LaneNodes& BeginLanes(uint padded_tiles);
+
+	// Multi source layer state, reset lazily like the nodes
+	void BeginLayers(uint width, uint height);
+	LayerTile& GetLayerTile(uint tile);
+	bool HasLayerTile(uint tile) const;
+
+private:
+
+	uint width;
+	uint height;
+	std::vector<PathNode> nodes;
+	// search that last touched each node
+	std::vector<uint> stamps;
+	uint stamp;
+	std::vector<OpenNode> open;
+	LaneNodes lanes;
+	std::vector<LayerTile> layer_tiles;
+	std::vector<uint> layer_stamps;
+	uint layer_stamp = 0;
+};
+
+inline PathNode* SearchContext::GetNode(int x, int y)
+{
+	uint index = (y*width) + x;
+
+	if (stamps[index] != stamp)
+	{
+		stamps[index] = stamp;
+		nodes[index] = PathNode(-1, -1, iPoint(x, y), nullptr);
+	}
+
+	return &nodes[index];
+}
+
+inline LayerTile& SearchContext::GetLayerTile(uint tile)
+{
+	if (layer_stamps[tile] != layer_stamp)
+	{
+		layer_stamps[tile] = layer_stamp;
+		layer_tiles[tile].visited = 0;
+		layer_tiles[tile].slot = 0;
+	}
+
+	return layer_tiles[tile];
+}
+
+inline bool SearchContext::HasLayerTile(uint tile) const
+{
+	return layer_stamps[tile] == layer_stamp;
+}
+
+inline void SearchContext::PushOpen(PathNode* node)
+{
+	open.push_back(OpenNode(node));
+	std::push_heap(open.begin(), open.end(), compare());
+}
+
+inline PathNode* SearchContext::PopOpen()
+{
+	if (open.size() == 0)
+		return nullptr;
+
+	std::pop_heap(open.begin(), open.end(), compare());
+	PathNode* ret = open.back().node;
+	open.pop_back();
+	return ret;
+}
+
+// ----------------------------------------------------------------------------------
+// A* over the context node map for any SearchPolicy -------------------------------
+// ----------------------------------------------------------------------------------
+template<class Policy, class Hooks>
+bool j1PathFinding::FindPath(SearchContext& context, const iPoint& origin, const iPoint& destination, std::vector<iPoint>& path_to_fill, Hooks& hooks) const
+{
+	if (memory_bounded == true || IsWalkable(origin) == false || IsWalkable(destination) == false)
+		return false;
+
+	//TODO 2
+	// Start with a clean node map, nodes are reset lazily by the context
+	context.Begin(width, height);
+
+	//TODO 5
+	//Inicialize firstNode getting its node and setting its position, g and h
+	PathNode* firstNode = context.GetNode(origin.x, origin.y);
+	firstNode->g = 0;
+	firstNode->h = hooks.H(origin, destination);
+	if (firstNode->h < 0)
+		return false;
+	firstNode->on_open = true;
+	context.PushOpen(firstNode);
+
+	//TODO 3 / 6
+	//Get the lowest score node of the open list as the current node and set it on_close
+	PathNode* current;
+	while ((current = context.PopOpen()) != nullptr)
+	{
+		if (current->on_close == true)
+			continue;
+		current->on_close = true;
+
+		if (current->pos == destination)
+		{
+			hooks.Done(current);
+
+			//TODO 8
+			// make a look for current, and until its parent is nullptr, make current = ParentNode
+			path_to_fill.clear();
+			for (const PathNode* item = current; item != nullptr; item = item->parent)
+				path_to_fill.push_back(item->pos);
+			std::reverse(path_to_fill.begin(), path_to_fill.end());
+			return true;
+		}
+
+		if (hooks.Expand(current) == false)
+			return false;
+
+		//TODO 7
+		//skip closed neighbours and only update open ones when they get a better g
+		auto visit = [&](int x, int y, int cost)
+		{
+			PathNode* node = context.GetNode(x, y);
+			if (node->on_close == true)
+				return;
+
+			float g = current->g + cost;
+			if (node->on_open == false)
+			{
+				int h = hooks.H(node->pos, destination);
+				if (h < 0)
+					return;
+
+				node->h = h;
+				node->on_open = true;
+			}
+			else if (g >= node->g)
+			{
+				return;
+			}
+
+			node->g = g;
+			node->parent = current;
+			context.PushOpen(node);
+		};
+		GridNeighbours<Policy>::Expand(map, width, height, current->pos.x, current->pos.y, visit);
+	}
+
+	hooks.Done(nullptr);
+	return false;
+}
+
+// ----------------------------------------------------------------------------------
+// Main thread A* into last_path: return ms spent or -1 ----------------------------
+// ----------------------------------------------------------------------------------
+template<class Policy>
+float j1PathFinding::CreatePathWith(const iPoint& origin, const iPoint& destination)
+{
+	j1PerfTimer timer;
+	SearchHooks<Policy> hooks;
+
+	if (FindPath<Policy>(GetSearchContext(), origin, destination, last_path, hooks) == false)
+		return -1;
+
+	PERF_PEEK(timer);
+	return timer.ReadMs();
+}
+
 #endif // __j1PATHFINDING_H__
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "j1Window.h"
 #include "j1Map.h"
 #include "j1PathFinding.h"
+#include "PathSmooth.h"
 #include "j1Scene.h"
 
 j1Scene::j1Scene() : j1Module()
@@ -38,6 +39,10 @@ bool j1Scene::Start()
 		if(App->map->CreateWalkabilityMap(w, h, &data))
 			App->pathfinding->SetMap(w, h, data);
 
+		std::vector<SDL_Rect> rooms, portals;
+		if (App->map->CreateRoomMap(rooms, portals))
+			App->pathfinding->SetRooms(rooms, portals);
+
 		RELEASE_ARRAY(data);
 	}
 
@@ -61,14 +66,21 @@ bool j1Scene::PreUpdate()
 			optimizedpathfinding = true;
 		else optimizedpathfinding = false;
 	}
+	if (App->input->GetKey(SDL_SCANCODE_2) == KEY_DOWN && origin_selected == false)
+		smoothpath = !smoothpath;
+	if (App->input->GetKey(SDL_SCANCODE_3) == KEY_DOWN && origin_selected == false)
+	{
+		static const char* names[] = { "default", "four way", "corner cutting", "straight biased", "dijkstra" };
+		rules = (rules + 1) % (sizeof(names) / sizeof(names[0]));
+		LOG("Optimized paths use the %s rule set", names[rules]);
+	}
 	if (App->input->GetMouseButtonDown(SDL_BUTTON_LEFT) == KEY_DOWN && optimizedpathfinding == false)
 	{
 		if (origin_selected == true)
 		{
 
 			lastnormaltime = App->pathfinding->CreatePath(origin, p);
-		
-			
+			SmoothLastPath();
 			origin_selected = false;
 		}
 		else
@@ -81,7 +93,17 @@ bool j1Scene::PreUpdate()
 	{
 		if (origin_selected == true)
 		{
-			lastoptimizedtime = App->pathfinding->CreatePathOptimized(origin, p);
+			// blocked or unreachable clicks go to the closest tile that can be reached,
+			// the other rule sets each run their own compiled kernel
+			switch (rules)
+			{
+			case 1: lastoptimizedtime = App->pathfinding->CreatePathWith<FourWaySearchPolicy>(origin, p); break;
+			case 2: lastoptimizedtime = App->pathfinding->CreatePathWith<CornerCuttingSearchPolicy>(origin, p); break;
+			case 3: lastoptimizedtime = App->pathfinding->CreatePathWith<StraightBiasedSearchPolicy>(origin, p); break;
+			case 4: lastoptimizedtime = App->pathfinding->CreatePathWith<DijkstraSearchPolicy>(origin, p); break;
+			default: lastoptimizedtime = App->pathfinding->CreatePathNearest(origin, p); break;
+			}
+			SmoothLastPath();
 			origin_selected = false;
 		}
 		else
@@ -153,8 +175,16 @@ bool j1Scene::Update(float dt)
 	App->render->Blit(debug_tex, p.x, p.y);
 
 	const std::vector<iPoint>* path = App->pathfinding->GetLastPath();
-	
-	if (path->size() != 0)
+
+	if (smoothpath == true && curve.size() != 0)
+	{
+		for (std::vector<fPoint>::const_iterator item = curve.begin(); item != curve.end(); ++item)
+		{
+			fPoint pos = App->map->MapToWorld(item->x, item->y);
+			App->render->Blit(debug_tex, (int)pos.x, (int)pos.y);
+		}
+	}
+	else if (path->size() != 0)
 	{
 		std::vector<iPoint>::const_iterator item = path->begin();
 
@@ -169,6 +199,18 @@ bool j1Scene::Update(float dt)
 	return true;
 }
 
+// Waypoints and curve of the last path when smoothing is on
+void j1Scene::SmoothLastPath()
+{
+	curve.clear();
+
+	if (smoothpath == true)
+	{
+		App->pathfinding->PostProcessLastPath(PATH_POST_COLLINEAR | PATH_POST_STRING_PULL);
+		CatmullRom(*App->pathfinding->GetLastPath(), DEFAULT_CURVE_SAMPLES, curve);
+	}
+}
+
 // Called each loop iteration
 bool j1Scene::PostUpdate()
 {
@@ -2,6 +2,8 @@
 #define __j1SCENE_H__
 
 #include "j1Module.h"
+#include "p2Point.h"
+#include <vector>
 
 struct SDL_Texture;
 class UILabel;
@@ -37,6 +39,8 @@ public:
 	bool CleanUp();
 
 private:
+	void SmoothLastPath();
+
 	SDL_Texture* debug_tex;
 
 	/* TEST UI
@@ -52,6 +56,11 @@ private:
 	bool optimizedpathfinding = false;
 	float lastoptimizedtime = 0;
 	float lastnormaltime = 0;
+	// paths are cut to waypoints and drawn as a curve through them
+	bool smoothpath = false;
+	// rule set of optimized paths, 0 is the default one (key 3 cycles them)
+	uint rules = 0;
+	std::vector<fPoint> curve;
 	int x_select = 0;
 	int y_select = 0;
 	int w = 0;
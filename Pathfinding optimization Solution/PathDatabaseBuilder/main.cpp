@@ -0,0 +1,97 @@
+#include "p2Defs.h"
+#include "PathDatabase.h"
+#include "PugiXml\src\pugixml.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// --------------------------------------------------
+// Offline builder for the compressed path databases:
+// PathDatabaseBuilder <map.tmx> <output.cpd> [threads]
+// The walkability map is read like j1Map::CreateWalkabilityMap does, so the
+// database matches the map the game hands to j1PathFinding::SetMap.
+// --------------------------------------------------
+
+// Walkability of the first layer with the Navigation property
+bool LoadWalkability(const char* path, uint& width, uint& height, std::vector<uchar>& walkability)
+{
+	pugi::xml_document document;
+	pugi::xml_parse_result result = document.load_file(path);
+
+	if (result == NULL)
+	{
+		printf("Could not load map xml file %s. pugi error: %s\n", path, result.description());
+		return false;
+	}
+
+	pugi::xml_node map = document.child("map");
+	width = map.attribute("width").as_uint();
+	height = map.attribute("height").as_uint();
+
+	std::vector<int> firstgids;
+	for (pugi::xml_node tileset = map.child("tileset"); tileset; tileset = tileset.next_sibling("tileset"))
+		firstgids.push_back(tileset.attribute("firstgid").as_int());
+
+	for (pugi::xml_node layer = map.child("layer"); layer; layer = layer.next_sibling("layer"))
+	{
+		bool navigation = false;
+		for (pugi::xml_node prop = layer.child("properties").child("property"); prop; prop = prop.next_sibling("property"))
+		{
+			if (strcmp(prop.attribute("name").as_string(), "Navigation") == 0)
+				navigation = prop.attribute("value").as_bool();
+		}
+
+		if (navigation == false)
+			continue;
+
+		walkability.assign(width*height, 1);
+
+		uint i = 0;
+		for (pugi::xml_node tile = layer.child("data").child("tile"); tile && i < width*height; tile = tile.next_sibling("tile"), ++i)
+		{
+			int tile_id = tile.attribute("gid").as_int(0);
+			if (tile_id <= 0 || firstgids.size() == 0)
+				continue;
+
+			// same tileset lookup as j1Map::GetTilesetFromTileId
+			int firstgid = firstgids.front();
+			for (uint set = 0; set < firstgids.size() && firstgids[set] <= tile_id; ++set)
+				firstgid = firstgids[set];
+
+			walkability[i] = (tile_id - firstgid) > 0 ? 0 : 1;
+		}
+
+		return true;
+	}
+
+	printf("Map %s has no Navigation layer\n", path);
+	return false;
+}
+
+int main(int argc, char* args[])
+{
+	if (argc < 3)
+	{
+		printf("usage: PathDatabaseBuilder <map.tmx> <output.cpd> [threads]\n");
+		return EXIT_FAILURE;
+	}
+
+	uint width, height;
+	std::vector<uchar> walkability;
+	if (LoadWalkability(args[1], width, height, walkability) == false)
+		return EXIT_FAILURE;
+
+	uint threads = (argc > 3) ? atoi(args[3]) : 0;
+	printf("Building path database for %s (%u x %u)\n", args[1], width, height);
+
+	PathDatabase database;
+	if (database.Build(width, height, walkability.data(), threads) == false || database.Save(args[2]) == false)
+	{
+		printf("Could not build %s\n", args[2]);
+		return EXIT_FAILURE;
+	}
+
+	printf("Saved %s\n", args[2]);
+	return EXIT_SUCCESS;
+}